@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 
+import numpy as np
 import pandas as pd
 import h5py
 
@@ -23,7 +24,16 @@ parser.add_argument('-d', '--dataset',
 args = parser.parse_args()
 
 result_file = h5py.File(args.inputFile, 'r')
-result_df = pd.DataFrame(result_file["corrcoef"])
+corrcoef = result_file["corrcoef"]
+values = corrcoef[()]
+
+# Decode 8-bit fixed point output
+if "scale_factor" in corrcoef.attrs:
+    missing = values == corrcoef.attrs["missing_value"]
+    values = values.astype(np.float32) * corrcoef.attrs["scale_factor"]
+    values[missing] = np.nan
+
+result_df = pd.DataFrame(values)
 
 if Path(args.dataset).suffix == ".h5":
     dataset_file = h5py.File(args.dataset, 'r')
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#endif
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "affinity.h"
+
+struct Topology {
+    // CPUs (usable by this process) belonging to each NUMA node
+    std::vector<std::vector<int>> node_cpus;
+    // NUMA node of each CPU
+    std::vector<uint32_t> cpu_node;
+};
+
+// Parse a Linux CPU list such as "0-15,32-47"
+static std::vector<int> parse_cpu_list(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+
+    while (std::getline(ss, range, ',')) {
+        const auto dash = range.find('-');
+
+        if (range.empty()) {
+            continue;
+        } else if (dash == std::string::npos) {
+            cpus.push_back(std::stoi(range));
+        } else {
+            const auto first = std::stoi(range.substr(0, dash));
+            const auto last = std::stoi(range.substr(dash + 1));
+
+            for (auto cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+
+    return cpus;
+}
+
+static Topology detect_topology()
+{
+    Topology topo;
+
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    std::vector<int> node_ids;
+    const auto dir = opendir("/sys/devices/system/node");
+
+    if (dir) {
+        while (const auto entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+
+            if (name.compare(0, 4, "node") == 0 && name.size() > 4 &&
+                std::isdigit(name[4])) {
+                node_ids.push_back(std::stoi(name.substr(4)));
+            }
+        }
+        closedir(dir);
+    }
+
+    std::sort(node_ids.begin(), node_ids.end());
+
+    for (const auto id : node_ids) {
+        std::ifstream ifs("/sys/devices/system/node/node" +
+                          std::to_string(id) + "/cpulist");
+        std::string list;
+        std::getline(ifs, list);
+
+        std::vector<int> cpus;
+        for (const auto cpu : parse_cpu_list(list)) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+
+        // Skip memory-only nodes
+        if (!cpus.empty()) {
+            topo.node_cpus.push_back(cpus);
+        }
+    }
+#endif
+
+    // Fall back to a single node holding all CPUs
+    if (topo.node_cpus.empty()) {
+        const auto n_cpus = std::max(1l, sysconf(_SC_NPROCESSORS_ONLN));
+
+        topo.node_cpus.resize(1);
+        for (auto cpu = 0; cpu < n_cpus; cpu++) {
+            topo.node_cpus[0].push_back(cpu);
+        }
+    }
+
+    for (auto node = 0u; node < topo.node_cpus.size(); node++) {
+        for (const auto cpu : topo.node_cpus[node]) {
+            if (static_cast<size_t>(cpu) >= topo.cpu_node.size()) {
+                topo.cpu_node.resize(cpu + 1, 0);
+            }
+            topo.cpu_node[cpu] = node;
+        }
+    }
+
+    return topo;
+}
+
+static const Topology &topology()
+{
+    static const Topology topo = detect_topology();
+    return topo;
+}
+
+uint32_t numa_node_count() { return topology().node_cpus.size(); }
+
+uint32_t current_numa_node()
+{
+#ifdef __linux__
+    const auto cpu = sched_getcpu();
+    const auto &cpu_node = topology().cpu_node;
+
+    if (cpu >= 0 && static_cast<size_t>(cpu) < cpu_node.size()) {
+        return cpu_node[cpu];
+    }
+#endif
+
+    return 0;
+}
+
+// clang-format off
+void pin_threads(const std::string &policy, uint32_t part, uint32_t n_parts)
+{
+    if (policy == "none") {
+        return;
+    } else if (policy != "compact" && policy != "scatter") {
+        throw std::invalid_argument("Unknown affinity policy " + policy);
+    }
+
+#ifdef __linux__
+    const auto &node_cpus = topology().node_cpus;
+    std::vector<int> order;
+
+    if (policy == "compact") {
+        for (const auto &cpus : node_cpus) {
+            order.insert(order.end(), cpus.begin(), cpus.end());
+        }
+    } else {
+        auto found = true;
+
+        for (auto i = 0u; found; i++) {
+            found = false;
+
+            for (const auto &cpus : node_cpus) {
+                if (i < cpus.size()) {
+                    order.push_back(cpus[i]);
+                    found = true;
+                }
+            }
+        }
+    }
+
+    // Share of the CPUs for this part. Parts share CPUs only if there are
+    // more parts than CPUs.
+    n_parts = std::max<uint32_t>(n_parts, 1);
+    const auto first = part * order.size() / n_parts;
+    const auto n_cpus = std::max<size_t>(
+        (part + 1) * order.size() / n_parts - first, 1);
+
+    #pragma omp parallel
+    {
+        #ifdef _OPENMP
+        const auto tid = omp_get_thread_num();
+        #else
+        const auto tid = 0;
+        #endif
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(order[(first + tid % n_cpus) % order.size()], &set);
+
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+}
+
+std::vector<DataFrame> replicate_per_node(const DataFrame &df)
+{
+    std::vector<DataFrame> replicas(numa_node_count());
+    std::vector<bool> claimed(replicas.size(), false);
+
+    #pragma omp parallel
+    {
+        const auto node = current_numa_node();
+        auto owner = false;
+
+        #pragma omp critical
+        {
+            if (!claimed[node]) {
+                claimed[node] = true;
+                owner = true;
+            }
+        }
+
+        // The first thread on each node copies the input
+        if (owner) {
+            replicas[node] = df;
+        }
+    }
+
+    return replicas;
+}
+// clang-format on
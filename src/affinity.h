@@ -0,0 +1,33 @@
+#ifndef __AFFINITY_H__
+#define __AFFINITY_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "data_frame.h"
+
+// Number of NUMA nodes in the system (1 if unknown)
+uint32_t numa_node_count();
+
+// NUMA node of the CPU the calling thread is currently running on
+uint32_t current_numa_node();
+
+// Pin every OpenMP thread of the calling thread to a CPU. `policy` is one
+// of:
+//   none:    leave placement to the OS
+//   compact: fill the CPUs of one NUMA node before moving to the next
+//   scatter: distribute threads round-robin across NUMA nodes
+// Concurrent thread pools, e.g. the workers of a ThreadScheduler, pass
+// their index `part` out of `n_parts` to be pinned to their own share of
+// the CPUs in the order given by `policy`.
+void pin_threads(const std::string &policy, uint32_t part = 0,
+                 uint32_t n_parts = 1);
+
+// Create one copy of `df` per NUMA node. Each copy is written by a thread
+// running on that node so that its pages are placed there by the first-touch
+// policy. Threads should be pinned beforehand. Nodes without any OpenMP
+// thread get an empty DataFrame.
+std::vector<DataFrame> replicate_per_node(const DataFrame &df);
+
+#endif
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <H5Fpublic.h>
+#include <highfive/H5DataSpace.hpp>
+
+#include "checkpoint.h"
+
+static HighFive::DataSet open_completed(HighFive::File &file, size_t n_rows)
+{
+    if (!file.exist("/completed")) {
+        return file.createDataSet<uint8_t>("/completed",
+                                           HighFive::DataSpace({n_rows}));
+    }
+
+    auto dataset = file.getDataSet("/completed");
+
+    if (dataset.getDimensions() != std::vector<size_t>{n_rows}) {
+        throw std::invalid_argument(
+            "Progress record does not match the input dataset");
+    }
+
+    return dataset;
+}
+
+Checkpoint::Checkpoint(HighFive::File &file, size_t n_rows)
+    : dataset(open_completed(file, n_rows)), flags(n_rows)
+{
+    // Flags that were never written read as the fill value zero
+    if (n_rows) {
+        dataset.read(flags);
+    }
+
+    // Persist the file structure before any rows are written
+    sync();
+}
+
+size_t Checkpoint::n_completed() const
+{
+    return std::count_if(flags.begin(), flags.end(),
+                         [](uint8_t flag) { return flag != 0; });
+}
+
+void Checkpoint::mark(size_t start, size_t n_rows)
+{
+    std::fill(flags.begin() + start, flags.begin() + start + n_rows, 1);
+
+    dataset.select({start}, {n_rows}).write_raw(flags.data() + start);
+}
+
+void Checkpoint::sync() { H5Fflush(dataset.getId(), H5F_SCOPE_GLOBAL); }
+
+Continuation plan_continuation(size_t n_columns, bool append,
+                               size_t n_stored_E,
+                               const std::vector<uint8_t> &completed)
+{
+    const auto n_old = completed.size();
+
+    if (append && n_old > 0 && n_old < n_columns) {
+        if (std::count(completed.begin(), completed.end(), 0)) {
+            throw std::invalid_argument(
+                "Previous run did not complete, resume it before appending");
+        }
+
+        if (n_old <= n_stored_E) {
+            return Continuation{n_old, n_old};
+        }
+    } else if (n_stored_E == n_columns) {
+        return Continuation{n_columns, 0};
+    }
+
+    throw std::invalid_argument("Output does not match the input dataset");
+}
+
+void CheckpointRowWriter::write_rows(size_t start, size_t n_rows,
+                                     const float *rows)
+{
+    sink.write_rows(start, n_rows, rows);
+
+    if (sync) {
+        checkpoint.sync();
+    }
+
+    checkpoint.mark(start, n_rows);
+}
+
+void CheckpointRowWriter::flush()
+{
+    sink.flush();
+
+    if (sync) {
+        checkpoint.sync();
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <highfive/H5DataSet.hpp>
+#include <highfive/H5File.hpp>
+
+#include "row_writer.h"
+
+// Progress record of an all-to-all run, stored as /completed next to the
+// results so that an interrupted run can be resumed. Every row (library)
+// has its own flag byte, so that MPI ranks can mark disjoint rows without
+// a read-modify-write of shared bytes.
+class Checkpoint
+{
+public:
+    // Open the record of `file`, or create one with no completed rows.
+    // Creation is collective if the file is opened by multiple MPI ranks.
+    Checkpoint(HighFive::File &file, size_t n_rows);
+
+    bool completed(size_t i) const { return flags[i]; }
+    size_t n_completed() const;
+    const std::vector<uint8_t> &completed_flags() const { return flags; }
+
+    // Flag `n_rows` consecutive rows starting at `start` as completed
+    void mark(size_t start, size_t n_rows);
+    // Flush the file to disk. Collective for MPI-IO files.
+    void sync();
+
+protected:
+    HighFive::DataSet dataset;
+    std::vector<uint8_t> flags;
+};
+
+// Leading columns of a previous run that a new run continues from
+struct Continuation {
+    // Columns whose embedding dimensions are reused
+    size_t n_known_E;
+    // Columns whose cross mappings with each other are complete, so that
+    // only the targets appended after them are computed for their rows.
+    // Zero if the output is finished like a resumed run.
+    size_t n_old;
+};
+
+// Decide how a run over `n_columns` columns continues an output holding
+// `n_stored_E` embedding dimensions and the progress record `completed`.
+// With `append`, a smaller record must be complete and its columns are
+// kept. A record of the full size is an interrupted update, or has no
+// columns appended, and is resumed. Throws std::invalid_argument if the
+// output does not match the input or its run did not complete.
+Continuation plan_continuation(size_t n_columns, bool append,
+                               size_t n_stored_E,
+                               const std::vector<uint8_t> &completed);
+
+// Forwards rows to `sink` and flags them as completed once written. With
+// `sync`, the file is flushed before rows are flagged so that a flag never
+// reaches the disk ahead of its row.
+class CheckpointRowWriter : public RowWriter
+{
+public:
+    CheckpointRowWriter(RowWriter &sink, Checkpoint &checkpoint, bool sync)
+        : RowWriter(sink.n_columns()), sink(sink), checkpoint(checkpoint),
+          sync(sync)
+    {
+    }
+
+    void write_rows(size_t start, size_t n_rows, const float *rows) override;
+    void flush() override;
+
+protected:
+    RowWriter &sink;
+    Checkpoint &checkpoint;
+    bool sync;
+};
+
+#endif
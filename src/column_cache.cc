@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "column_cache.h"
+
+const size_t ColumnCache::BLOCKS_PER_CACHE;
+
+ColumnCache::ColumnCache(const DataFrame &df, size_t capacity)
+    : df(df), mapping(df.mapping()), _hits(0), _misses(0), _evictions(0)
+{
+    if (!mapping) {
+        throw std::invalid_argument(
+            "Column cache requires a memory-mapped DataFrame");
+    }
+
+    const auto column_bytes = std::max<size_t>(df.n_rows(), 1) * sizeof(float);
+
+    _block_columns =
+        std::max<size_t>(capacity / BLOCKS_PER_CACHE / column_bytes, 1);
+    capacity_blocks = BLOCKS_PER_CACHE;
+}
+
+void ColumnCache::acquire(size_t first, size_t last)
+{
+    last = std::min(last, df.n_columns());
+
+    for (auto b = first / _block_columns; b * _block_columns < last; b++) {
+        if (touch(b)) {
+            _hits++;
+        } else {
+            _misses++;
+        }
+    }
+
+    evict_overflow();
+}
+
+void ColumnCache::prefetch(size_t first, size_t last)
+{
+    last = std::min(last, df.n_columns());
+
+    for (auto b = first / _block_columns; b * _block_columns < last; b++) {
+        touch(b);
+    }
+
+    evict_overflow();
+}
+
+bool ColumnCache::touch(size_t block)
+{
+    const auto it = resident.find(block);
+
+    if (it != resident.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        return true;
+    }
+
+    mapping->prefetch(block_offset(block), block_length(block));
+
+    lru.push_front(block);
+    resident[block] = lru.begin();
+
+    return false;
+}
+
+void ColumnCache::evict_overflow()
+{
+    while (lru.size() > capacity_blocks) {
+        const auto block = lru.back();
+
+        mapping->evict(block_offset(block), block_length(block));
+
+        resident.erase(block);
+        lru.pop_back();
+        _evictions++;
+    }
+}
+
+size_t ColumnCache::block_offset(size_t block) const
+{
+    const auto first = std::min(block * _block_columns, df.n_columns());
+
+    return reinterpret_cast<const char *>(df.data() + first * df.n_rows()) -
+           mapping->data();
+}
+
+size_t ColumnCache::block_length(size_t block) const
+{
+    const auto first = std::min(block * _block_columns, df.n_columns());
+    const auto last = std::min(first + _block_columns, df.n_columns());
+
+    return (last - first) * df.n_rows() * sizeof(float);
+}
@@ -0,0 +1,58 @@
+#ifndef __COLUMN_CACHE_H__
+#define __COLUMN_CACHE_H__
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include "data_frame.h"
+
+// Keeps a bounded number of column blocks of a memory-mapped DataFrame
+// resident, so that datasets larger than memory can be streamed through the
+// cross mapping kernels. Blocks are evicted in LRU order. Evicted columns
+// stay readable and are faulted in again from the file on access.
+class ColumnCache
+{
+public:
+    // `df` must be loaded with DataFrame::load_binary() and outlive the
+    // cache. The cache holds up to `capacity` bytes in blocks of
+    // capacity / BLOCKS_PER_CACHE bytes.
+    ColumnCache(const DataFrame &df, size_t capacity);
+
+    static const size_t BLOCKS_PER_CACHE = 4;
+
+    size_t n_columns() const { return df.n_columns(); }
+    size_t block_columns() const { return _block_columns; }
+
+    // Make columns [first, last) resident before they are used
+    void acquire(size_t first, size_t last);
+    // Start reading columns [first, last) in the background
+    void prefetch(size_t first, size_t last);
+
+    size_t hits() const { return _hits; }
+    size_t misses() const { return _misses; }
+    size_t evictions() const { return _evictions; }
+
+protected:
+    const DataFrame &df;
+    std::shared_ptr<const MappedFile> mapping;
+    size_t _block_columns;
+    size_t capacity_blocks;
+
+    // Resident blocks, most recently used first
+    std::list<size_t> lru;
+    std::unordered_map<size_t, std::list<size_t>::iterator> resident;
+
+    size_t _hits;
+    size_t _misses;
+    size_t _evictions;
+
+    // Returns true if the block was already resident
+    bool touch(size_t block);
+    void evict_overflow();
+    size_t block_offset(size_t block) const;
+    size_t block_length(size_t block) const;
+};
+
+#endif
@@ -2,27 +2,84 @@
 #define __CROSS_MAPPING_H__
 
 #include <cstdint>
+#include <vector>
 
+#include "affinity.h"
+#include "column_cache.h"
 #include "data_frame.h"
 
 class CrossMapping
 {
 public:
     CrossMapping(uint32_t max_E, uint32_t tau, uint32_t Tp, bool verbose)
-        : max_E(max_E), tau(tau), Tp(Tp), verbose(verbose)
+        : max_E(max_E), tau(tau), Tp(Tp), verbose(verbose),
+          replica_source(nullptr), target_replicas(nullptr), memory_budget(0),
+          column_cache(nullptr)
     {
     }
     virtual ~CrossMapping() {}
 
-    virtual void run(std::vector<float> &rhos, const Series &library,
+    // Cross map from `library` to every target and store the correlation
+    // coefficients to rhos[0], ..., rhos[targets.size() - 1]
+    virtual void run(float *rhos, const Series &library,
                      const std::vector<Series> &targets,
                      const std::vector<uint32_t> &optimal_E) = 0;
 
+    void run(std::vector<float> &rhos, const Series &library,
+             const std::vector<Series> &targets,
+             const std::vector<uint32_t> &optimal_E)
+    {
+        run(rhos.data(), library, targets, optimal_E);
+    }
+
+    // Read targets from per-NUMA-node replicas of `source` created by
+    // replicate_per_node(). Replicas are only used when run() is passed the
+    // columns of `source` itself.
+    void set_target_replicas(const DataFrame &source,
+                             const std::vector<DataFrame> *replicas)
+    {
+        replica_source = &source;
+        target_replicas = replicas;
+    }
+
+    // Limit the memory used by the lookup tables and k-NN scratch space to
+    // `bytes`. Zero means unlimited.
+    void set_memory_budget(size_t bytes) { memory_budget = bytes; }
+
+    // Stream targets through `cache` in tiles of its block size, prefetching
+    // the next tile while the current one is processed. The cache must hold
+    // the same columns as the targets passed to run().
+    void set_column_cache(ColumnCache *cache) { column_cache = cache; }
+
 protected:
     uint32_t max_E;
     uint32_t tau;
     uint32_t Tp;
     bool verbose;
+    const DataFrame *replica_source;
+    const std::vector<DataFrame> *target_replicas;
+    size_t memory_budget;
+    ColumnCache *column_cache;
+
+    // Targets replicated on the NUMA node of the calling thread, or `targets`
+    // itself if no replica is available
+    const std::vector<Series> &
+    local_targets(const std::vector<Series> &targets) const
+    {
+        if (!target_replicas || &targets != &replica_source->columns) {
+            return targets;
+        }
+
+        const auto &replica = (*target_replicas)[current_numa_node()];
+
+        // Nodes without an OpenMP thread have no replica
+        if (replica.n_columns() != targets.size() ||
+            replica.n_rows() != replica_source->n_rows()) {
+            return targets;
+        }
+
+        return replica.columns;
+    }
 };
 
 #endif
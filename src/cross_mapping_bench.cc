@@ -1,79 +1,395 @@
 #include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
 
+#include <H5Lpublic.h>
 #include <argh.h>
 #include <highfive/H5DataSet.hpp>
 #include <highfive/H5DataSpace.hpp>
 #include <highfive/H5File.hpp>
 
+#include "affinity.h"
+#include "checkpoint.h"
+#include "column_cache.h"
 #include "cross_mapping_cpu.h"
 #include "data_frame.h"
+#include "edge_list.h"
 #include "embedding_dim_cpu.h"
+#include "memory_planner.h"
+#include "output_layout.h"
+#include "row_writer.h"
 #ifdef ENABLE_GPU_KERNEL
 #include "cross_mapping_gpu.h"
 #include "embedding_dim_gpu.h"
 #endif
 #include "stats.h"
+#include "task_planner.h"
+#include "thread_scheduler.h"
 #include "timer.h"
+#include "uninitialized_vector.h"
 
+// Find the optimal embedding dimension of every column from `first` on.
+// Those of the previous columns are kept.
 template <class T>
-void find_embedding_dim(HighFive::File file, std::vector<uint32_t> &optimal_E,
-                        uint32_t max_E, const DataFrame &df, bool verbose)
+void find_embedding_dim(std::vector<uint32_t> &optimal_E, size_t first,
+                        uint32_t max_E, const DataFrame &df, size_t mem_limit,
+                        const std::string &search, uint32_t patience,
+                        uint32_t stride, uint32_t n_folds, bool verbose)
 {
     // max_E=20, tau=1, Tp=1
     auto embedding_dim =
         std::unique_ptr<EmbeddingDim>(new T(max_E, 1, 1, verbose));
 
-    optimal_E.resize(df.n_columns());
+    embedding_dim->set_memory_budget(mem_limit);
+    embedding_dim->set_search_policy(search, patience, stride);
+    embedding_dim->set_folds(n_folds);
 
-    for (auto i = 0u; i < df.n_columns(); i++) {
-        if (verbose) {
-            std::cout << "Find embedding dimension for column #" << i
-                      << std::endl;
-        }
+    if (verbose) {
+        std::cout << "Find embedding dimension for columns #" << first
+                  << " to #" << df.n_columns() - 1 << std::endl;
+    }
+
+    const std::vector<Series> columns(df.columns.begin() + first,
+                                      df.columns.end());
+    const auto best_E = embedding_dim->run_batch(columns);
+
+    optimal_E.resize(first);
+    optimal_E.insert(optimal_E.end(), best_E.begin(), best_E.end());
+
+    const auto n_evaluated = embedding_dim->n_evaluated();
+    const auto n_exhaustive = embedding_dim->n_exhaustive();
+
+    std::cout << "Evaluated " << n_evaluated << " of " << n_exhaustive
+              << " embedding dimensions (saved "
+              << n_exhaustive - n_evaluated << ")" << std::endl;
+}
+
+void unlink_dataset(HighFive::File &file, const std::string &name)
+{
+    if (H5Ldelete(file.getId(), name.c_str(), H5P_DEFAULT) < 0) {
+        throw std::runtime_error("Failed to delete dataset " + name);
+    }
+}
 
-        const auto ts = df.columns[i];
-        const auto best_E = embedding_dim->run(ts);
+// Open the dense output of a run being resumed, or grow it to n_columns x
+// n_columns if columns were appended. Create it otherwise.
+HighFive::DataSet open_corrcoef(HighFive::File &file, size_t n_columns,
+                                size_t n_old, const OutputLayout &layout)
+{
+    if (n_old) {
+        return resize_float_dataset(file, "/corrcoef", n_columns, n_columns);
+    } else if (file.exist("/corrcoef")) {
+        return file.getDataSet("/corrcoef");
+    }
+
+    return create_float_dataset(file, "/corrcoef", n_columns, n_columns,
+                                layout);
+}
+
+// Rows per block written by AsyncRowWriter: whole chunks, or about 4 MiB if
+// not chunked
+size_t write_block_rows(const OutputLayout &layout, size_t n_columns,
+                        size_t n_written_columns)
+{
+    const auto chunk_rows = layout.effective_chunk_rows(n_columns);
 
-        optimal_E[i] = best_E;
+    if (chunk_rows) {
+        return chunk_rows;
     }
 
-    const auto dataspace = HighFive::DataSpace::From(optimal_E);
-    auto dataset = file.createDataSet<uint32_t>("/embedding", dataspace);
-    dataset.write(optimal_E);
+    return std::max<size_t>(
+        (4 << 20) / (std::max<size_t>(n_written_columns, 1) * sizeof(float)),
+        1);
 }
 
+// Destination of the rows computed by CrossMappingWorkers. Workers run
+// concurrently, so rows are handed over while holding `mutex`.
+struct CrossMappingOutput {
+    // Rows are computed in place if not null
+    MmapRowWriter *raw;
+    EdgeCollector *edges;
+    RowWriter *writer;
+    std::mutex mutex;
+};
+
+// Issues the cross mapping tasks planned for a run
+class CrossMappingMaster : public TaskMaster
+{
+public:
+    explicit CrossMappingMaster(const std::vector<TaskRange> &tasks)
+        : current_id(0), tasks(tasks)
+    {
+    }
+
+protected:
+    size_t current_id;
+    std::vector<TaskRange> tasks;
+
+    void next_task(Task &task) override
+    {
+        task.start = tasks[current_id].start;
+        task.stop = tasks[current_id].stop;
+        current_id++;
+    }
+
+    bool task_left() const override { return current_id < tasks.size(); }
+};
+
+// Cross maps runs of libraries onto `targets` with its own kernel
+class CrossMappingWorker : public TaskWorker
+{
+public:
+    CrossMappingWorker(CrossMapping &xmap, CrossMappingOutput &output,
+                       const DataFrame &df, const std::vector<Series> &targets,
+                       const std::vector<uint32_t> &target_E, bool verbose)
+        : xmap(xmap), output(output), df(df), targets(targets),
+          target_E(target_E), verbose(verbose)
+    {
+    }
+
+protected:
+    CrossMapping &xmap;
+    CrossMappingOutput &output;
+    const DataFrame &df;
+    const std::vector<Series> &targets;
+    const std::vector<uint32_t> &target_E;
+    bool verbose;
+    std::vector<float> rows;
+
+    void do_task(TaskResult &result, const Task &task) override
+    {
+        const auto n_targets = targets.size();
+        rows.resize((task.stop - task.start) * n_targets);
+
+        for (auto i = task.start; i < task.stop; i++) {
+            if (verbose) {
+                std::lock_guard<std::mutex> lock(output.mutex);
+                std::cout << "Cross mapping from column #" << i << std::endl;
+            }
+
+            const auto rhos = output.raw
+                                  ? output.raw->row(i)
+                                  : rows.data() + (i - task.start) * n_targets;
+
+            xmap.run(rhos, df.columns[i], targets, target_E);
+        }
+
+        std::lock_guard<std::mutex> lock(output.mutex);
+
+        if (output.edges) {
+            for (auto i = task.start; i < task.stop; i++) {
+                const auto row = rows.begin() + (i - task.start) * n_targets;
+
+                output.edges->add_row(
+                    i, std::vector<float>(row, row + n_targets));
+            }
+        } else if (output.writer) {
+            output.writer->write_rows(task.start, task.stop - task.start,
+                                      rows.data());
+        }
+
+        result.start = task.start;
+        result.stop = task.stop;
+    }
+};
+
+// Cross map all columns of `df` onto each other. The first `n_old` columns
+// are already cross mapped onto each other in `file`, so only their rows
+// for the remaining targets are computed.
 template <class T>
-void cross_mapping(HighFive::File file, uint32_t max_E, const DataFrame &df,
-                   const std::vector<uint32_t> &optimal_E, bool verbose)
+void cross_mapping(HighFive::File *file, MmapRowWriter *raw, uint32_t max_E,
+                   const DataFrame &df, size_t n_old,
+                   const std::vector<uint32_t> &optimal_E,
+                   const std::vector<DataFrame> &replicas, ColumnCache *cache,
+                   const OutputLayout &layout, EdgeCollector *edges,
+                   size_t mem_limit, size_t n_workers, const std::string &bind,
+                   bool verbose)
 {
-    Timer timer_io;
+    // Every worker owns its kernel. max_E=20, tau=1, Tp=0
+    std::vector<std::unique_ptr<CrossMapping>> xmaps;
+
+    for (auto i = 0u; i < n_workers; i++) {
+        auto xmap = std::unique_ptr<CrossMapping>(new T(max_E, 1, 0, verbose));
 
-    std::vector<float> rhos(df.n_columns());
+        if (!replicas.empty()) {
+            xmap->set_target_replicas(df, &replicas);
+        }
 
-    // max_E=20, tau=1, Tp=0
-    auto xmap = std::unique_ptr<CrossMapping>(new T(max_E, 1, 0, verbose));
+        // Workers run at once, so they share the budget
+        xmap->set_memory_budget(mem_limit / n_workers);
+
+        if (cache) {
+            xmap->set_column_cache(cache);
+        }
+
+        xmaps.push_back(std::move(xmap));
+    }
+
+    // Targets appended since the output was written
+    const std::vector<Series> new_targets(df.columns.begin() + n_old,
+                                          df.columns.end());
+    const std::vector<uint32_t> new_E(optimal_E.begin() + n_old,
+                                      optimal_E.end());
+
+    std::unique_ptr<HDF5RowWriter> sink, old_sink;
+    std::unique_ptr<Checkpoint> checkpoint;
+    std::unique_ptr<CheckpointRowWriter> recorder, old_recorder;
+    std::unique_ptr<AsyncRowWriter> writer, old_writer;
+
+    // Keep only the strongest edges instead of the dense matrix if requested.
+    // Raw output is written in place.
+    if (!raw && !edges) {
+        auto dataset = open_corrcoef(*file, df.n_columns(), n_old, layout);
+
+        if (dataset.getDimensions() !=
+            std::vector<size_t>{df.n_columns(), df.n_columns()}) {
+            throw std::invalid_argument(
+                "Output does not match the input dataset");
+        }
+
+        // Write from a background thread
+        checkpoint.reset(new Checkpoint(*file, df.n_columns()));
+        sink.reset(new HDF5RowWriter(dataset));
+        recorder.reset(new CheckpointRowWriter(*sink, *checkpoint, true));
+        writer.reset(new AsyncRowWriter(
+            *recorder,
+            write_block_rows(layout, df.n_columns(), df.n_columns())));
+
+        if (n_old) {
+            old_sink.reset(
+                new HDF5RowWriter(dataset, n_old, new_targets.size()));
+            old_recorder.reset(
+                new CheckpointRowWriter(*old_sink, *checkpoint, true));
+            old_writer.reset(new AsyncRowWriter(
+                *old_recorder,
+                write_block_rows(layout, df.n_columns(), new_targets.size())));
+        }
+
+        if (checkpoint->n_completed()) {
+            std::cout << "Resuming after " << checkpoint->n_completed()
+                      << " of " << df.n_columns() << " completed libraries"
+                      << std::endl;
+        }
+    }
+
+    // A single worker processes one library per task in order, as a plain
+    // loop would. Multiple workers take runs of consecutive libraries so
+    // that rows still reach the output in large blocks.
+    const auto libraries_per_task =
+        n_workers > 1
+            ? std::max<size_t>(
+                  std::min(write_block_rows(layout, df.n_columns(),
+                                            df.n_columns()),
+                           df.n_columns() / (4 * n_workers)),
+                  1)
+            : 1;
+
+    // Cross map the libraries [first, last) left to do onto `targets`
+    const auto run = [&](size_t first, size_t last,
+                         const std::vector<Series> &targets,
+                         const std::vector<uint32_t> &target_E,
+                         RowWriter *writer) {
+        std::vector<uint8_t> skipped(df.n_columns(), 1);
+
+        for (auto i = first; i < last; i++) {
+            skipped[i] = checkpoint && checkpoint->completed(i);
+        }
 
-    const auto dataspace =
-        HighFive::DataSpace({df.n_columns(), df.n_columns()});
-    auto dataset = file.createDataSet<float>("/corrcoef", dataspace);
+        CrossMappingMaster master(plan_fixed_tasks(
+            std::vector<double>(df.n_columns(), 1.0), skipped,
+            libraries_per_task));
+        CrossMappingOutput output = {raw, edges, writer};
 
-    for (auto i = 0u; i < df.n_columns(); i++) {
-        const auto library = df.columns[i];
+        std::vector<std::unique_ptr<CrossMappingWorker>> workers;
+        std::vector<TaskWorker *> worker_ptrs;
 
-        if (verbose) {
-            std::cout << "Cross mapping from column #" << i << std::endl;
+        for (const auto &xmap : xmaps) {
+            workers.push_back(std::unique_ptr<CrossMappingWorker>(
+                new CrossMappingWorker(*xmap, output, df, targets, target_E,
+                                       verbose)));
+            worker_ptrs.push_back(workers.back().get());
         }
 
-        xmap->run(rhos, library, df.columns, optimal_E);
+        ThreadScheduler scheduler(bind);
+        scheduler.run(master, worker_ptrs);
+    };
 
+    if (n_old) {
+        run(0, n_old, new_targets, new_E, old_writer.get());
+
+        // The HDF5 library is not used by two threads at once
+        old_writer->flush();
+    }
+
+    run(n_old, df.n_columns(), df.columns, optimal_E, writer.get());
+
+    if (edges) {
+        Timer timer_io;
         timer_io.start();
-        dataset.select({i, 0}, {1, df.n_columns()}).write(rhos);
+
+        const auto csr = edges->to_csr();
+
+        create_edge_datasets(*file, df.n_columns(), csr.indices.size());
+        write_edge_list(*file, csr);
+
         timer_io.stop();
+
+        std::cout << "Wrote " << csr.indices.size() << " edges in "
+                  << timer_io.elapsed() << " [ms]" << std::endl;
+    } else if (raw) {
+        Timer timer_io;
+        timer_io.start();
+
+        raw->flush();
+
+        timer_io.stop();
+
+        std::cout << "Total IO write: " << timer_io.elapsed() << " [ms]"
+                  << std::endl;
+    } else {
+        if (old_writer) {
+            old_writer->flush();
+        }
+        writer->flush();
+
+        auto io_time = writer->io_time(), wait_time = writer->wait_time();
+
+        if (old_writer) {
+            io_time += old_writer->io_time();
+            wait_time += old_writer->wait_time();
+        }
+
+        std::cout << "Total IO write: " << io_time
+                  << " [ms], IO wait: " << wait_time << " [ms]" << std::endl;
     }
+}
 
-    std::cout << "Total IO write: " << timer_io.elapsed() << " [ms]"
-              << std::endl;
+// Describe a raw output matrix in a JSON sidecar file
+void write_raw_header(const std::string &path, size_t n_columns,
+                      const std::vector<uint32_t> &optimal_E)
+{
+    std::ofstream ofs(path);
+
+    ofs << "{\n"
+        << "  \"shape\": [" << n_columns << ", " << n_columns << "],\n"
+        << "  \"dtype\": \"<f4\",\n"
+        << "  \"order\": \"C\",\n"
+        << "  \"rows\": \"library\",\n"
+        << "  \"columns\": \"target\",\n"
+        << "  \"embedding\": [";
+
+    for (auto i = 0u; i < optimal_E.size(); i++) {
+        ofs << (i ? ", " : "") << optimal_E[i];
+    }
+
+    ofs << "]\n}" << std::endl;
+
+    if (!ofs) {
+        throw std::runtime_error("Failed to write file " + path);
+    }
 }
 
 bool ends_with(const std::string &str, const std::string &suffix)
@@ -94,11 +410,47 @@ void usage(const std::string &app_name)
         "  " +
         app_name +
         " [OPTION...] INPUT OUTPUT\n"
+        "\n"
+        "OUTPUT is an HDF5 file, or a raw float32 matrix with a JSON header\n"
+        "(OUTPUT.json) if it ends with .raw\n"
+        "\n"
         "  -t, --tau arg        Lag (default: 1)\n"
         "  -e, --maxe arg       Maximum embedding dimension (default: 20)\n"
         "  -p, --Tp arg         Steps to predict in future (default: 1)\n"
         "  -x, --kernel arg     Kernel type {cpu|gpu} (default: cpu)\n"
+        "  -s, --search arg     E search {exhaustive|patience|coarse} "
+        "(default:\n"
+        "                       exhaustive)\n"
+        "  -P, --patience arg   Steps without improvement before the patience "
+        "search\n"
+        "                       stops (default: 3)\n"
+        "  -S, --stride arg     Grid spacing of the coarse search (default: "
+        "4)\n"
+        "  -f, --folds arg      Select E by cross validation over {K|loo} "
+        "folds\n"
+        "                       (default: predict second half from first)\n"
         "  -d, --dataset arg    HDF5 dataset name\n"
+        "  -b, --bind arg       Pin threads {none|compact|scatter}\n"
+        "  -r, --replicate      Replicate input on every NUMA node\n"
+        "  -m, --mem-limit arg  Memory budget for k-NN, e.g. 16G, split "
+        "among workers\n"
+        "                       (default: unlimited)\n"
+        "  -c, --cache arg      Stream .mpedm input through a column cache of "
+        "this size\n"
+        "  -j, --workers arg    Libraries cross mapped concurrently, each on "
+        "its own\n"
+        "                       share of the CPUs with -b (default: 1)\n"
+        "  -k, --chunk-rows arg Rows per output chunk (default: contiguous)\n"
+        "  -z, --compress arg   Output deflate level 0-9 (default: 0)\n"
+        "  -q, --quantize arg   Store output as {none|fp16|int8} (default: "
+        "none)\n"
+        "  -K, --top-k arg      Only store the K strongest edges per target\n"
+        "  -T, --threshold arg  Only store edges with rho >= threshold\n"
+        "  -R, --resume         Skip libraries completed by a previous run\n"
+        "  -a, --append         Only compute the columns appended to INPUT "
+        "since\n"
+        "                       OUTPUT was written\n"
+        "  -H, --huge-pages     Back scratch buffers with huge pages\n"
         "  -v, --verbose        Enable verbose logging (default: false)\n"
         "  -h, --help           Show help";
 
@@ -108,7 +460,12 @@ void usage(const std::string &app_name)
 int main(int argc, char *argv[])
 {
     argh::parser cmdl({"-t", "--tau", "-p", "--tp", "-e", "--maxe", "-x",
-                       "--kernel", "-d", "--dataset"});
+                       "--kernel", "-s", "--search", "-P", "--patience", "-S",
+                       "--stride", "-f", "--folds", "-d", "--dataset", "-b",
+                       "--bind", "-m", "--mem-limit", "-c", "--cache", "-j",
+                       "--workers", "-k", "--chunk-rows", "-z", "--compress",
+                       "-q", "--quantize", "-K", "--top-k", "-T",
+                       "--threshold"});
     cmdl.parse(argc, argv);
 
     if (cmdl[{"-h", "--help"}]) {
@@ -139,10 +496,64 @@ int main(int argc, char *argv[])
     cmdl({"e", "maxe"}, 20) >> max_E;
     std::string kernel_type;
     cmdl({"x", "kernel"}, "cpu") >> kernel_type;
+    std::string search;
+    cmdl({"s", "search"}, "exhaustive") >> search;
+    uint32_t patience;
+    cmdl({"P", "patience"}, 3) >> patience;
+    uint32_t stride;
+    cmdl({"S", "stride"}, 4) >> stride;
+    std::string folds;
+    cmdl({"f", "folds"}, "0") >> folds;
+    uint32_t n_folds = EmbeddingDim::leave_one_out;
+    if (folds != "loo") {
+        auto valid = false;
+
+        try {
+            size_t end;
+            const auto n = std::stoul(folds, &end);
+
+            // stoul accepts negative numbers. A single fold leaves no
+            // library to predict from.
+            valid = end == folds.size() && folds[0] != '-' && n != 1 &&
+                    n < EmbeddingDim::leave_one_out;
+            n_folds = n;
+        } catch (const std::logic_error &) {
+        }
+
+        if (!valid) {
+            std::cerr << "Invalid number of folds " << folds << std::endl;
+            usage(cmdl[0]);
+            return 1;
+        }
+    }
     std::string dataset_name;
     cmdl({"d", "dataset"}) >> dataset_name;
+    std::string bind;
+    cmdl({"b", "bind"}, "none") >> bind;
+    bool replicate = cmdl[{"r", "replicate"}];
+    std::string mem_limit_str;
+    cmdl({"m", "mem-limit"}, "0") >> mem_limit_str;
+    const auto mem_limit = MemoryPlanner::parse_size(mem_limit_str);
+    std::string cache_size_str;
+    cmdl({"c", "cache"}, "0") >> cache_size_str;
+    const auto cache_size = MemoryPlanner::parse_size(cache_size_str);
+    size_t n_workers;
+    cmdl({"j", "workers"}, 1) >> n_workers;
+    OutputLayout layout;
+    cmdl({"k", "chunk-rows"}, 0) >> layout.chunk_rows;
+    cmdl({"z", "compress"}, 0) >> layout.compression;
+    cmdl({"q", "quantize"}, "none") >> layout.quantization;
+    size_t top_k;
+    cmdl({"K", "top-k"}, 0) >> top_k;
+    std::string threshold_str;
+    cmdl({"T", "threshold"}) >> threshold_str;
+    bool resume = cmdl[{"R", "resume"}];
+    bool append = cmdl[{"a", "append"}];
     bool verbose = cmdl[{"v", "verbose"}];
 
+    ScratchArena::set_huge_pages(cmdl[{"H", "huge-pages"}]);
+    pin_threads(bind);
+
     Timer timer_tot, timer_io, timer_simplex, timer_xmap;
 
     std::cout << "Input: " << input_fname << std::endl;
@@ -164,6 +575,8 @@ int main(int argc, char *argv[])
         }
 
         df.load_hdf5(input_fname, dataset_name);
+    } else if (ends_with(input_fname, ".mpedm")) {
+        df.load_binary(input_fname);
     } else {
         std::cerr << "Unknown file type" << std::endl;
         usage(cmdl[0]);
@@ -176,23 +589,134 @@ int main(int argc, char *argv[])
               << df.n_columns() << " columns) in " << timer_io.elapsed()
               << " [ms]" << std::endl;
 
-    HighFive::File file(output_fname, HighFive::File::Overwrite);
+    std::unique_ptr<ColumnCache> cache;
+
+    if (!n_workers) {
+        std::cerr << "Need at least one worker" << std::endl;
+        return 1;
+    }
+
+    if (cache_size) {
+        if (!df.is_mapped()) {
+            std::cerr << "Column cache requires .mpedm input" << std::endl;
+            return 1;
+        }
+
+        // The cache is not thread-safe
+        if (n_workers > 1) {
+            std::cerr << "Column cache requires a single worker" << std::endl;
+            return 1;
+        }
+
+        cache.reset(new ColumnCache(df, cache_size));
+
+        std::cout << "Streaming input through a column cache ("
+                  << cache->block_columns() << " columns per block)"
+                  << std::endl;
+    }
+
+    std::vector<DataFrame> replicas;
+
+    if (replicate) {
+        replicas = replicate_per_node(df);
+
+        std::cout << "Replicated input dataset on " << replicas.size()
+                  << " NUMA nodes" << std::endl;
+    }
+
+    std::unique_ptr<EdgeCollector> edges;
+
+    if (top_k || !threshold_str.empty()) {
+        const auto threshold = threshold_str.empty()
+                                   ? -std::numeric_limits<float>::infinity()
+                                   : std::stof(threshold_str);
+
+        edges.reset(new EdgeCollector(df.n_columns(), top_k, threshold));
+    }
+
+    const auto raw_output = ends_with(output_fname, ".raw");
+
+    if (raw_output && edges) {
+        std::cerr << "Edge list output requires HDF5 output" << std::endl;
+        return 1;
+    }
+
+    // Edge lists are only written at the end of a run
+    if ((resume || append) && (raw_output || edges)) {
+        std::cerr << "Resuming requires dense HDF5 output" << std::endl;
+        return 1;
+    }
+
+    const auto output_exists = std::ifstream(output_fname).good();
+
+    if (append && !output_exists) {
+        std::cerr << "No output to append to" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<HighFive::File> file;
+    std::unique_ptr<MmapRowWriter> raw;
+
+    if (raw_output) {
+        raw.reset(
+            new MmapRowWriter(output_fname, df.n_columns(), df.n_columns()));
+    } else if ((resume || append) && output_exists) {
+        file.reset(new HighFive::File(output_fname, HighFive::File::ReadWrite));
+    } else {
+        file.reset(new HighFive::File(output_fname, HighFive::File::Overwrite));
+    }
+
     std::vector<uint32_t> optimal_E;
+    // Columns whose cross mappings with each other are already in the output
+    size_t n_old = 0;
+
+    // Reuse the embedding dimensions found by the run being resumed or
+    // appended to. The progress record is created after they are written,
+    // so they are only complete if the record exists.
+    if (file && file->exist("/embedding") && file->exist("/completed")) {
+        file->getDataSet("/embedding").read(optimal_E);
+
+        std::vector<uint8_t> completed;
+        file->getDataSet("/completed").read(completed);
+
+        try {
+            const auto plan = plan_continuation(df.n_columns(), append,
+                                                optimal_E.size(), completed);
+
+            optimal_E.resize(plan.n_known_E);
+            n_old = plan.n_old;
+        } catch (const std::invalid_argument &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    } else if (append) {
+        std::cerr << "Previous run did not complete, resume it before "
+                     "appending"
+                  << std::endl;
+        return 1;
+    }
+
+    const auto n_known_E = optimal_E.size();
 
     timer_simplex.start();
 
-    if (kernel_type == "cpu") {
+    if (n_known_E == df.n_columns()) {
+        std::cout << "Using optimal embedding dimensions of previous run"
+                  << std::endl;
+    } else if (kernel_type == "cpu") {
         std::cout << "Using CPU Simplex kernel" << std::endl;
 
-        find_embedding_dim<EmbeddingDimCPU>(file, optimal_E, max_E, df,
-                                            verbose);
+        find_embedding_dim<EmbeddingDimCPU>(optimal_E, n_known_E, max_E, df,
+                                            mem_limit, search, patience,
+                                            stride, n_folds, verbose);
     }
 #ifdef ENABLE_GPU_KERNEL
     else if (kernel_type == "gpu") {
         std::cout << "Using GPU Simplex kernel" << std::endl;
 
-        find_embedding_dim<EmbeddingDimGPU>(file, optimal_E, max_E, df,
-                                            verbose);
+        find_embedding_dim<EmbeddingDimGPU>(optimal_E, n_known_E, max_E, df,
+                                            mem_limit, search, patience,
+                                            stride, n_folds, verbose);
     }
 #endif
     else {
@@ -202,6 +726,23 @@ int main(int argc, char *argv[])
 
     timer_simplex.stop();
 
+    if (raw) {
+        write_raw_header(output_fname + ".json", df.n_columns(), optimal_E);
+    } else if (n_known_E < df.n_columns()) {
+        // Rows of old libraries are incomplete until their new targets are
+        // written, and the old record no longer vouches for the embedding
+        if (file->exist("/completed")) {
+            unlink_dataset(*file, "/completed");
+        }
+        if (file->exist("/embedding")) {
+            unlink_dataset(*file, "/embedding");
+        }
+
+        auto dataset = file->createDataSet<uint32_t>(
+            "/embedding", HighFive::DataSpace::From(optimal_E));
+        dataset.write(optimal_E);
+    }
+
     std::cout << "Computed optimal embedding dimensions in "
               << timer_simplex.elapsed() << " [ms]" << std::endl;
 
@@ -210,13 +751,19 @@ int main(int argc, char *argv[])
     if (kernel_type == "cpu") {
         std::cout << "Using CPU cross mapping kernel" << std::endl;
 
-        cross_mapping<CrossMappingCPU>(file, max_E, df, optimal_E, verbose);
+        cross_mapping<CrossMappingCPU>(file.get(), raw.get(), max_E, df,
+                                       n_old, optimal_E, replicas, cache.get(),
+                                       layout, edges.get(), mem_limit,
+                                       n_workers, bind, verbose);
     }
 #ifdef ENABLE_GPU_KERNEL
     else if (kernel_type == "gpu") {
         std::cout << "Using GPU cross mapping kernel" << std::endl;
 
-        cross_mapping<CrossMappingGPU>(file, max_E, df, optimal_E, verbose);
+        cross_mapping<CrossMappingGPU>(file.get(), raw.get(), max_E, df,
+                                       n_old, optimal_E, replicas, cache.get(),
+                                       layout, edges.get(), mem_limit,
+                                       n_workers, bind, verbose);
     }
 #endif
     else {
@@ -238,5 +785,15 @@ int main(int argc, char *argv[])
         df.n_columns() * df.n_columns() * 1000 / timer_tot.elapsed();
     std::cout << xps << " cross mappings per second" << std::endl;
 
+    if (verbose) {
+        ScratchArena::print_stats(std::cout);
+
+        if (cache) {
+            std::cout << "Column cache: " << cache->hits() << " hits, "
+                      << cache->misses() << " misses, " << cache->evictions()
+                      << " evictions" << std::endl;
+        }
+    }
+
     return 0;
 }
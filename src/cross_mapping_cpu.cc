@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <iostream>
 
 #include "cross_mapping_cpu.h"
+#include "memory_planner.h"
 #include "stats.h"
 #include "timer.h"
 
@@ -18,9 +20,9 @@
 #endif
 
 // clang-format off
-void CrossMappingCPU::run(std::vector<float> &rhos, const Series &library,
-                              const std::vector<Series> &targets,
-                              const std::vector<uint32_t> &optimal_E)
+void CrossMappingCPU::run(float *rhos, const Series &library,
+                          const std::vector<Series> &targets,
+                          const std::vector<uint32_t> &optimal_E)
 {
     LIKWID_MARKER_INIT;
 #pragma omp parallel
@@ -33,37 +35,96 @@ void CrossMappingCPU::run(std::vector<float> &rhos, const Series &library,
 
     Timer t1, t2;
 
-    // Compute k-NN lookup tables for library timeseries
-    t1.start();
-    for (auto E = 1u; E <= max_E; E++) {
-        knn->compute_lut(luts[E - 1], library, library, E);
-        luts[E - 1].normalize();
-    }
-    t1.stop();
+    // Only compute lookup tables for the embedding dimensions used by the
+    // targets, in groups that fit into the memory budget
+    std::vector<uint32_t> Es(optimal_E.begin(), optimal_E.end());
+    std::sort(Es.begin(), Es.end());
+    Es.erase(std::unique(Es.begin(), Es.end()), Es.end());
 
-    // cppcheck-suppress variableScope
-    std::vector<float> buffer;
-    // Compute Simplex projection from the library to every target
-    t2.start();
-    #pragma omp parallel
-    {
-        LIKWID_MARKER_START("lookup");
+    const auto groups = MemoryPlanner(memory_budget)
+                            .lut_groups(Es, library.size(), tau, Tp);
+
+    std::vector<bool> in_group(max_E + 1);
 
-        #pragma omp for private(buffer) schedule(dynamic)
-        for (auto i = 0u; i < targets.size(); i++) {
-            const auto E = optimal_E[i];
+    for (const auto &group : groups) {
+        std::fill(in_group.begin(), in_group.end(), false);
 
-            const auto target = targets[i];
-            const auto prediction =
-                simplex->predict(buffer, luts[E - 1], target, E);
-            const auto shifted_target = simplex->shift_target(target, E);
+        // Compute k-NN lookup tables for library timeseries
+        t1.start();
+        size_t held_bytes = 0;
+        for (const auto E : group) {
+            // Leave room for the lookup tables computed so far
+            if (memory_budget) {
+                knn->set_memory_budget(held_bytes < memory_budget
+                                           ? memory_budget - held_bytes
+                                           : 1);
+            }
 
-            rhos[i] = corrcoef(prediction, shifted_target);
+            knn->compute_lut(luts[E - 1], library, library, E);
+            luts[E - 1].normalize();
+
+            held_bytes += MemoryPlanner::lut_bytes(luts[E - 1].n_rows(),
+                                                   luts[E - 1].n_columns());
+            in_group[E] = true;
         }
+        t1.stop();
+
+        // Process targets in tiles of cached columns if a column cache is
+        // used, otherwise all at once
+        ColumnCache *cache = nullptr;
+        if (column_cache && column_cache->n_columns() == targets.size()) {
+            cache = column_cache;
+        }
+        const auto tile = cache ? cache->block_columns() : targets.size();
+
+        // cppcheck-suppress variableScope
+        scratch_vector<float> buffer;
+        // Compute Simplex projection from the library to every target
+        t2.start();
+        #pragma omp parallel
+        {
+            LIKWID_MARKER_START("lookup");
+
+            const auto &local = local_targets(targets);
+
+            for (size_t first = 0; first < targets.size(); first += tile) {
+                const auto last = std::min(first + tile, targets.size());
 
-        LIKWID_MARKER_STOP("lookup");
+                #pragma omp single
+                if (cache) {
+                    cache->acquire(first, last);
+                    cache->prefetch(last, last + tile);
+                }
+
+                #pragma omp for private(buffer) schedule(dynamic)
+                for (auto i = first; i < last; i++) {
+                    const auto E = optimal_E[i];
+
+                    if (!in_group[E]) {
+                        continue;
+                    }
+
+                    const auto target = local[i];
+                    const auto prediction =
+                        simplex->predict(buffer, luts[E - 1], target, E);
+                    const auto shifted_target =
+                        simplex->shift_target(target, E);
+
+                    rhos[i] = corrcoef(prediction, shifted_target);
+                }
+            }
+
+            LIKWID_MARKER_STOP("lookup");
+        }
+        t2.stop();
+
+        // Release lookup tables before computing the next group
+        if (groups.size() > 1) {
+            for (const auto E : group) {
+                luts[E - 1].release();
+            }
+        }
     }
-    t2.stop();
 
     if (verbose) {
         std::cout << "k-NN: " << t1.elapsed() << " [ms], Simplex: "
@@ -18,7 +18,9 @@ public:
     {
     }
 
-    void run(std::vector<float> &rhos, const Series &library,
+    using CrossMapping::run;
+
+    void run(float *rhos, const Series &library,
              const std::vector<Series> &targets,
              const std::vector<uint32_t> &optimal_E) override;
 
@@ -19,7 +19,7 @@ CrossMappingGPU::CrossMappingGPU(uint32_t max_E, uint32_t tau, uint32_t Tp,
 }
 
 // clang-format off
-void CrossMappingGPU::run(std::vector<float> &rhos, const Series &library,
+void CrossMappingGPU::run(float *rhos, const Series &library,
                           const std::vector<Series> &targets,
                           const std::vector<uint32_t> &optimal_E)
 {
@@ -46,19 +46,24 @@ void CrossMappingGPU::run(std::vector<float> &rhos, const Series &library,
     }
     t1.stop();
 
-    std::vector<float> buffer;
+    scratch_vector<float> buffer;
     // Compute Simplex projection from the library to every target
     t2.start();
-    #pragma omp parallel for private(buffer) schedule(dynamic)
-    for (auto i = 0u; i < targets.size(); i++) {
-        const auto E = optimal_E[i];
+    #pragma omp parallel
+    {
+        const auto &local = local_targets(targets);
+
+        #pragma omp for private(buffer) schedule(dynamic)
+        for (auto i = 0u; i < targets.size(); i++) {
+            const auto E = optimal_E[i];
 
-        const auto target = targets[i];
-        const auto prediction =
-            simplex->predict(buffer, luts[E - 1], target, E);
-        const auto shifted_target = simplex->shift_target(target, E);
+            const auto target = local[i];
+            const auto prediction =
+                simplex->predict(buffer, luts[E - 1], target, E);
+            const auto shifted_target = simplex->shift_target(target, E);
 
-        rhos[i] = corrcoef(prediction, shifted_target);
+            rhos[i] = corrcoef(prediction, shifted_target);
+        }
     }
     t2.stop();
 
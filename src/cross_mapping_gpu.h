@@ -13,7 +13,9 @@ class CrossMappingGPU : public CrossMapping
 public:
     CrossMappingGPU(uint32_t max_E, uint32_t tau, uint32_t Tp, bool verbose);
 
-    void run(std::vector<float> &rhos, const Series &library,
+    using CrossMapping::run;
+
+    void run(float *rhos, const Series &library,
              const std::vector<Series> &targets,
              const std::vector<uint32_t> &optimal_E) override;
 
@@ -1,15 +1,29 @@
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <limits>
 
 #include <argh.h>
 #include <highfive/H5DataSet.hpp>
 #include <highfive/H5DataSpace.hpp>
 #include <highfive/H5File.hpp>
 
+#include "affinity.h"
+#include "checkpoint.h"
 #include "cross_mapping_cpu.h"
 #include "data_frame.h"
+#include "edge_list.h"
 #include "embedding_dim_cpu.h"
+#include "memory_planner.h"
 #include "mpi_master.h"
+#include "mpi_rma_scheduler.h"
+#include "mpi_row_aggregator.h"
+#include "mpi_shared_data_frame.h"
 #include "mpi_worker.h"
+#include "output_layout.h"
+#include "row_writer.h"
+#include "task_planner.h"
+#include "thread_scheduler.h"
 #ifdef ENABLE_GPU_KERNEL
 #include "cross_mapping_gpu.h"
 #include "embedding_dim_gpu.h"
@@ -26,6 +40,21 @@ struct Parameters {
     std::string kernel_type;
     std::string dataset_name;
     uint32_t chunk_size;
+    uint32_t embedding_chunk_size;
+    uint32_t n_threads;
+    std::string scheduler;
+    bool guided;
+    std::string share_input;
+    std::string write_mode;
+    int n_aggregators;
+    size_t io_buffer;
+    bool async_io;
+    std::string bind;
+    size_t mem_limit;
+    OutputLayout layout;
+    size_t top_k;
+    float threshold;
+    bool resume;
     bool verbose;
 };
 
@@ -34,144 +63,306 @@ class EmbeddingDimMPIMaster : public MPIMaster
 public:
     std::vector<uint32_t> optimal_E;
 
-    EmbeddingDimMPIMaster(const DataFrame &df, MPI_Comm comm)
+    // Tasks are issued in the order of `tasks`. Progress is printed every
+    // tenth of all columns if `report_progress` is set.
+    EmbeddingDimMPIMaster(const DataFrame &df,
+                          const std::vector<TaskRange> &tasks,
+                          bool report_progress, MPI_Comm comm)
         : MPIMaster(comm), optimal_E(df.n_columns()), current_id(0),
-          dataframe(df)
+          tasks(tasks), report_progress(report_progress), n_finished(0),
+          n_reported(0)
     {
     }
     ~EmbeddingDimMPIMaster() {}
 
 protected:
-    uint32_t current_id;
-    DataFrame dataframe;
+    size_t current_id;
+    std::vector<TaskRange> tasks;
+    bool report_progress;
+    size_t n_finished;
+    size_t n_reported;
 
-    void next_task(nlohmann::json &task) override
+    void next_task(MPITask &task) override
     {
-        task["id"] = current_id;
+        task.start = tasks[current_id].start;
+        task.stop = tasks[current_id].stop;
         current_id++;
     }
 
-    bool task_left() const override
-    {
-        return current_id < dataframe.n_columns();
-    }
+    bool task_left() const override { return current_id < tasks.size(); }
 
-    void task_done(const nlohmann::json &result) override
+    // clang-format off
+    void task_done(const MPIResult &result) override
     {
-        std::cout << "Timeseries #" << result["id"] << " best E=" << result["E"]
-                  << std::endl;
+        // Exceptions cannot leave the OpenMP task calling this, so a
+        // malformed result aborts the run
+        if (result.start > result.stop || result.stop > optimal_E.size() ||
+            result.E.size() != result.stop - result.start) {
+            std::cerr << "Malformed embedding dimension result for ["
+                      << result.start << ", " << result.stop << ")"
+                      << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+
+        std::copy(result.E.begin(), result.E.end(),
+                  optimal_E.begin() + result.start);
+
+        #pragma omp critical
+        {
+            n_finished += result.stop - result.start;
+
+            const auto step = std::max<size_t>(optimal_E.size() / 10, 1);
 
-        optimal_E[result["id"]] = result["E"];
+            if (report_progress && n_finished >= n_reported + step) {
+                n_reported = n_finished;
+
+                std::cout << "Found optimal E of " << n_finished << " / "
+                          << optimal_E.size() << " timeseries" << std::endl;
+            }
+        }
     }
+    // clang-format on
 };
 
 template <class T> class EmbeddingDimMPIWorker : public MPIWorker
 {
 public:
-    EmbeddingDimMPIWorker(const DataFrame &df, bool verbose, MPI_Comm comm)
+    EmbeddingDimMPIWorker(const DataFrame &df, size_t mem_limit, bool verbose,
+                          MPI_Comm comm)
         : MPIWorker(comm),
           embedding_dim(std::unique_ptr<EmbeddingDim>(new T(20, 1, 1, true))),
           dataframe(df), verbose(verbose)
     {
+        embedding_dim->set_memory_budget(mem_limit);
     }
     ~EmbeddingDimMPIWorker() {}
 
 protected:
     std::unique_ptr<EmbeddingDim> embedding_dim;
-    DataFrame dataframe;
+    const DataFrame &dataframe;
     bool verbose;
 
-    void do_task(nlohmann::json &result, const nlohmann::json &task) override
+    void do_task(MPIResult &result, const MPITask &task) override
     {
-        const auto id = task["id"];
-        const auto ts = dataframe.columns[id];
-        const auto best_E = embedding_dim->run(ts);
+        result.start = task.start;
+        result.stop = task.stop;
+
+        const std::vector<Series> columns(
+            dataframe.columns.begin() + task.start,
+            dataframe.columns.begin() + task.stop);
 
-        result["id"] = id;
-        result["E"] = best_E;
+        result.E = embedding_dim->run_batch(columns);
     }
 };
 
 class CrossMappingMPIMaster : public MPIMaster
 {
 public:
-    CrossMappingMPIMaster(const DataFrame &df, uint32_t chunk_size,
-                          MPI_Comm comm)
-        : MPIMaster(comm), current_id(0), dataframe(df), chunk_size(chunk_size)
+    // Runtime of every finished task in [ms]
+    std::vector<float> runtimes;
+
+    // Tasks are issued in the order of `tasks`
+    CrossMappingMPIMaster(const std::vector<TaskRange> &tasks, MPI_Comm comm)
+        : MPIMaster(comm), current_id(0), tasks(tasks)
     {
     }
     ~CrossMappingMPIMaster() {}
 
 protected:
     size_t current_id;
-    DataFrame dataframe;
-    size_t chunk_size;
+    std::vector<TaskRange> tasks;
 
-    void next_task(nlohmann::json &task) override
+    void next_task(MPITask &task) override
     {
-        task["start_id"] = current_id;
-        task["stop_id"] =
-            std::min(current_id + chunk_size, dataframe.n_columns());
-        current_id += chunk_size;
+        task.start = tasks[current_id].start;
+        task.stop = tasks[current_id].stop;
+        current_id++;
     }
 
-    bool task_left() const override
+    bool task_left() const override { return current_id < tasks.size(); }
+
+    void task_done(const MPIResult &result) override
     {
-        return current_id < dataframe.n_columns();
+        std::cout << "Timeseries #" << result.start << " - #"
+                  << result.stop - 1 << " finished." << std::endl;
+
+        // clang-format off
+        #pragma omp critical
+        runtimes.push_back(result.elapsed);
+        // clang-format on
     }
+};
 
-    void task_done(const nlohmann::json &result) override
+// Splits a task into tasks of a single library
+class LibraryMaster : public TaskMaster
+{
+public:
+    explicit LibraryMaster(const MPITask &task)
+        : current_id(task.start), stop_id(task.stop)
     {
-        std::cout << "Timeseries #" << result["start_id"] << " - #"
-                  << result["stop_id"].get<int>() - 1 << " finished."
-                  << std::endl;
+    }
+
+protected:
+    uint64_t current_id;
+    uint64_t stop_id;
+
+    void next_task(Task &task) override
+    {
+        task.start = current_id;
+        task.stop = ++current_id;
+    }
+
+    bool task_left() const override { return current_id < stop_id; }
+};
+
+// Cross maps single libraries onto all columns with its own kernel
+class LibraryWorker : public TaskWorker
+{
+public:
+    LibraryWorker(std::unique_ptr<CrossMapping> xmap, const DataFrame &df,
+                  const std::vector<uint32_t> &optimal_E)
+        : xmap(std::move(xmap)), dataframe(df), optimal_E(optimal_E),
+          rows(nullptr), first_id(0)
+    {
+    }
+
+    // Write the row of library `i` to rows[i - first_id]
+    void set_output(float *rows, uint64_t first_id)
+    {
+        this->rows = rows;
+        this->first_id = first_id;
+    }
+
+protected:
+    std::unique_ptr<CrossMapping> xmap;
+    const DataFrame &dataframe;
+    const std::vector<uint32_t> &optimal_E;
+    float *rows;
+    uint64_t first_id;
+
+    void do_task(TaskResult &result, const Task &task) override
+    {
+        xmap->run(rows + (task.start - first_id) * dataframe.n_columns(),
+                  dataframe.columns[task.start], dataframe.columns, optimal_E);
+
+        result.start = task.start;
+        result.stop = task.stop;
     }
 };
 
 template <class T> class CrossMappingMPIWorker : public MPIWorker
 {
 public:
-    CrossMappingMPIWorker(HighFive::DataSet dataset, const DataFrame &df,
-                          const std::vector<uint32_t> &optimal_E, bool verbose,
-                          MPI_Comm comm)
-        : MPIWorker(comm), dataset(dataset),
-          xmap(std::unique_ptr<CrossMapping>(new T(20, 1, 0, true))),
-          dataframe(df), optimal_E(optimal_E), verbose(verbose)
+    // Results are written to `writer`, or collected into `edges` if it is
+    // not null. If `async_rows` is not zero, rows are handed to a background
+    // thread in blocks of up to `async_rows` rows and the worker continues
+    // with its next task while they are written. The libraries of a task
+    // are cross mapped by `n_threads` threads, each with its own kernel,
+    // share of `mem_limit` and share of the CPUs pinned according to `bind`.
+    CrossMappingMPIWorker(RowWriter *writer, EdgeCollector *edges,
+                          const DataFrame &df,
+                          const std::vector<uint32_t> &optimal_E,
+                          size_t mem_limit, size_t async_rows,
+                          size_t n_threads, const std::string &bind,
+                          bool verbose, MPI_Comm comm)
+        : MPIWorker(comm), writer(writer), edges(edges),
+          async_writer(writer && async_rows
+                           ? new AsyncRowWriter(*writer, async_rows)
+                           : nullptr),
+          dataframe(df), optimal_E(optimal_E), verbose(verbose),
+          scheduler(bind)
     {
+        n_threads = std::max<size_t>(n_threads, 1);
+
+        for (auto i = 0u; i < n_threads; i++) {
+            auto xmap = std::unique_ptr<CrossMapping>(new T(20, 1, 0, true));
+            xmap->set_memory_budget(mem_limit / n_threads);
+
+            library_workers.push_back(
+                std::unique_ptr<LibraryWorker>(new LibraryWorker(
+                    std::move(xmap), dataframe, this->optimal_E)));
+            library_worker_ptrs.push_back(library_workers.back().get());
+        }
     }
     ~CrossMappingMPIWorker() {}
 
+    // Wait until all rows have been written. Must be called before the
+    // output file is accessed by this thread again.
+    void flush_output()
+    {
+        if (async_writer) {
+            timer_io.start();
+            async_writer->flush();
+            timer_io.stop();
+        }
+    }
+
+    // Time the worker spent writing or waiting for output to be written
     float total_io_time() { return timer_io.elapsed(); }
+    // Time the worker spent cross mapping
+    float total_compute_time() { return timer_compute.elapsed(); }
+    // Time the background thread spent writing
+    float background_io_time()
+    {
+        return async_writer ? async_writer->io_time() : 0.0f;
+    }
 
 protected:
-    HighFive::DataSet dataset;
-    std::unique_ptr<CrossMapping> xmap;
-    DataFrame dataframe;
+    RowWriter *writer;
+    EdgeCollector *edges;
+    std::unique_ptr<AsyncRowWriter> async_writer;
+    const DataFrame &dataframe;
     std::vector<uint32_t> optimal_E;
     bool verbose;
+    std::vector<std::unique_ptr<LibraryWorker>> library_workers;
+    std::vector<TaskWorker *> library_worker_ptrs;
+    ThreadScheduler scheduler;
     Timer timer_io;
+    Timer timer_compute;
 
-    void do_task(nlohmann::json &result, const nlohmann::json &task) override
+    void do_task(MPIResult &result, const MPITask &task) override
     {
-        const uint32_t start_id = task["start_id"];
-        const uint32_t stop_id = task["stop_id"];
+        const uint32_t start_id = task.start;
+        const uint32_t stop_id = task.stop;
         uint32_t task_size = stop_id - start_id;
 
-        std::vector<std::vector<float>> rhos(
-            task_size, std::vector<float>(dataframe.n_columns()));
+        std::vector<float> rows(task_size * dataframe.n_columns());
 
-        for (uint32_t i = 0; i < task_size; i++) {
-            const auto library = dataframe.columns[start_id + i];
-            xmap->run(rhos[i], library, dataframe.columns, optimal_E);
+        timer_compute.start();
+
+        for (const auto &library_worker : library_workers) {
+            library_worker->set_output(rows.data(), start_id);
         }
 
-        timer_io.start();
-        dataset.select({start_id, 0}, {task_size, dataframe.n_columns()})
-            .write(rhos);
-        timer_io.stop();
+        LibraryMaster library_master(task);
+        scheduler.run(library_master, library_worker_ptrs);
+
+        timer_compute.stop();
+
+        if (edges) {
+            for (uint32_t i = 0; i < task_size; i++) {
+                const auto row = rows.begin() + i * dataframe.n_columns();
+
+                edges->add_row(start_id + i,
+                               std::vector<float>(
+                                   row, row + dataframe.n_columns()));
+            }
+        }
 
-        result["start_id"] = start_id;
-        result["stop_id"] = stop_id;
+        if (async_writer) {
+            // Only waits if the background thread is behind
+            timer_io.start();
+            async_writer->write_rows(start_id, task_size, rows.data());
+            async_writer->submit();
+            timer_io.stop();
+        } else if (!edges) {
+            timer_io.start();
+            writer->write_rows(start_id, task_size, rows.data());
+            timer_io.stop();
+        }
+
+        result.start = start_id;
+        result.stop = stop_id;
     }
 };
 
@@ -183,29 +374,295 @@ bool ends_with(const std::string &str, const std::string &suffix)
     return str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
 }
 
+// Merge the edges collected by every rank into `edges` on rank 0. Ranks
+// are received one at a time in pieces so that neither MPI counts nor the
+// receive buffer grow with the total number of edges.
+void gather_edges(EdgeCollector &edges, int rank, MPI_Comm comm)
+{
+    // Edges per message, well below INT_MAX
+    const size_t PIECE = 1 << 20;
+    const int TAG = 0;
+
+    int size;
+    MPI_Comm_size(comm, &size);
+
+    MPI_Datatype edge_type;
+    MPI_Type_contiguous(sizeof(Edge), MPI_BYTE, &edge_type);
+    MPI_Type_commit(&edge_type);
+
+    if (rank) {
+        const auto local = edges.edges();
+        const uint64_t count = local.size();
+
+        MPI_Send(&count, 1, MPI_UINT64_T, 0, TAG, comm);
+
+        for (size_t i = 0; i < count; i += PIECE) {
+            const int n = std::min<size_t>(PIECE, count - i);
+            MPI_Send(local.data() + i, n, edge_type, 0, TAG, comm);
+        }
+    } else {
+        // Edges collected by rank 0 itself are already in `edges`
+        std::vector<Edge> piece;
+
+        for (auto r = 1; r < size; r++) {
+            uint64_t count;
+            MPI_Recv(&count, 1, MPI_UINT64_T, r, TAG, comm,
+                     MPI_STATUS_IGNORE);
+
+            for (size_t i = 0; i < count; i += PIECE) {
+                const int n = std::min<size_t>(PIECE, count - i);
+                piece.resize(n);
+                MPI_Recv(piece.data(), n, edge_type, r, TAG, comm,
+                         MPI_STATUS_IGNORE);
+                edges.merge(piece);
+            }
+        }
+    }
+
+    MPI_Type_free(&edge_type);
+}
+
+// Split the libraries left to do into tasks
+std::vector<TaskRange> plan_tasks(const DataFrame &df,
+                                  const std::vector<uint8_t> &completed,
+                                  const Parameters &parameters, int n_workers)
+{
+    // Every library has the same length and is mapped onto every target
+    // with the same embedding dimensions, so libraries cost the same and
+    // guided tasks are ordered by their number of libraries. This matters
+    // when resuming, where the runs of libraries left differ in length.
+    const std::vector<double> costs(df.n_columns(), 1.0);
+
+    // Every thread of a worker should get at least one library
+    const auto chunk_size =
+        std::max(parameters.chunk_size, parameters.n_threads);
+
+    if (parameters.guided) {
+        return plan_guided_tasks(costs, completed, n_workers, chunk_size);
+    }
+    return plan_fixed_tasks(costs, completed, chunk_size);
+}
+
+// Libraries [start, stop) whose rows are written out together
+struct Round {
+    size_t start;
+    size_t stop;
+    std::vector<TaskRange> tasks;
+};
+
+// Split the libraries left to do into rounds of `round_rows` libraries
+std::vector<Round> plan_rounds(const DataFrame &df,
+                               const std::vector<uint8_t> &completed,
+                               const Parameters &parameters, int n_workers,
+                               size_t round_rows)
+{
+    std::vector<Round> rounds;
+
+    for (size_t start = 0; start < df.n_columns(); start += round_rows) {
+        const auto stop = std::min(start + round_rows, df.n_columns());
+
+        // Libraries of other rounds are treated as completed
+        std::vector<uint8_t> skipped(df.n_columns(), 1);
+        std::copy(completed.begin() + start, completed.begin() + stop,
+                  skipped.begin() + start);
+
+        Round round = {start, stop,
+                       plan_tasks(df, skipped, parameters, n_workers)};
+        rounds.push_back(round);
+    }
+
+    return rounds;
+}
+
+struct RunStats {
+    // Tasks run by this rank
+    uint64_t n_tasks;
+    // Time spent writing output or waiting for it to be written in [ms]
+    float io_time;
+    // Time spent cross mapping in [ms]
+    float compute_time;
+    // Time the background writer thread spent writing in [ms]
+    float background_io_time;
+    // Runtime of every task whose result was received by this rank
+    std::vector<float> runtimes;
+};
+
+// Run all rounds with `worker`, or as the dedicated master rank if `worker`
+// is null. Rows buffered by `aggregator` are written after every round.
+void run_rounds(const std::vector<Round> &rounds, MPIWorker *worker,
+                MPIRowAggregator *aggregator, bool rma, RunStats &stats)
+{
+    for (const auto &round : rounds) {
+        CrossMappingMPIMaster master(round.tasks, MPI_COMM_WORLD);
+
+        if (rma) {
+            MPIRMAScheduler scheduler(MPI_COMM_WORLD);
+
+            scheduler.run(master, *worker);
+            stats.n_tasks += scheduler.n_local_tasks();
+        } else if (worker) {
+            worker->run();
+        } else {
+            master.run();
+        }
+
+        stats.runtimes.insert(stats.runtimes.end(), master.runtimes.begin(),
+                              master.runtimes.end());
+
+        if (aggregator) {
+            Timer timer_io;
+
+            timer_io.start();
+            aggregator->exchange(round.start, round.stop);
+            stats.io_time += timer_io.stop();
+        }
+    }
+}
+
+// Print the distribution of the task runtimes [ms] recorded by every rank
+void report_runtimes(const std::vector<float> &runtimes, int rank,
+                     MPI_Comm comm)
+{
+    int size;
+    MPI_Comm_size(comm, &size);
+
+    const int count = runtimes.size();
+    std::vector<int> counts(size), displs(size);
+    MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+
+    std::vector<float> all;
+    if (!rank) {
+        for (auto i = 1; i < size; i++) {
+            displs[i] = displs[i - 1] + counts[i - 1];
+        }
+        all.resize(displs[size - 1] + counts[size - 1]);
+    }
+
+    MPI_Gatherv(runtimes.data(), count, MPI_FLOAT, all.data(), counts.data(),
+                displs.data(), MPI_FLOAT, 0, comm);
+
+    if (rank || all.empty()) {
+        return;
+    }
+
+    std::sort(all.begin(), all.end());
+
+    const auto percentile = [&](size_t p) {
+        return all[(all.size() - 1) * p / 100];
+    };
+
+    std::cout << "Task runtime: min " << all.front() << ", median "
+              << percentile(50) << ", p90 " << percentile(90) << ", max "
+              << all.back() << " [ms] over " << all.size() << " tasks"
+              << std::endl;
+}
+
 void run(int rank, const DataFrame &df, const Parameters &parameters)
 {
+    // Continue writing into the output of a previous run if resuming
+    int resuming = 0;
+    if (!rank) {
+        resuming = parameters.resume &&
+                   std::ifstream(parameters.output_fname).good();
+    }
+    MPI_Bcast(&resuming, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
     HighFive::File file(
-        parameters.output_fname, HighFive::File::Overwrite,
+        parameters.output_fname,
+        resuming ? HighFive::File::ReadWrite : HighFive::File::Overwrite,
         HighFive::MPIOFileDriver(MPI_COMM_WORLD, MPI_INFO_NULL));
 
+    // Reuse the embedding dimensions found by the run being resumed. They
+    // are complete once the progress record has been created.
+    const auto resumed_E = file.exist("/completed");
     const auto dataspace_embedding = HighFive::DataSpace({df.n_columns()});
     auto dataset_embedding =
-        file.createDataSet<uint32_t>("/embedding", dataspace_embedding);
+        file.exist("/embedding")
+            ? file.getDataSet("/embedding")
+            : file.createDataSet<uint32_t>("/embedding", dataspace_embedding);
+
+    if (dataset_embedding.getDimensions() !=
+        std::vector<size_t>{df.n_columns()}) {
+        throw std::invalid_argument("Output does not match the input dataset");
+    }
 
     std::vector<uint32_t> optimal_E(df.n_columns());
 
+    int comm_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+
+    // Rank 0 only schedules unless tasks are claimed through RMA
+    const auto n_workers =
+        parameters.scheduler == "rma" ? comm_size : comm_size - 1;
+
+    // Evaluating E costs about the same for every column, so only the
+    // number of columns per task matters
+    const auto embedding_tasks = plan_guided_tasks(
+        std::vector<double>(df.n_columns(), 1.0),
+        std::vector<uint8_t>(df.n_columns(), 0), n_workers,
+        parameters.embedding_chunk_size);
+
     Timer timer;
 
     if (!rank) {
         std::cout << "Input: " << parameters.input_fname << std::endl;
         std::cout << "Output: " << parameters.output_fname << std::endl;
 
-        EmbeddingDimMPIMaster embedding_dim_master(df, MPI_COMM_WORLD);
+        timer.start();
+    }
+
+    if (resumed_E) {
+        dataset_embedding.read(optimal_E);
+
+        if (!rank) {
+            std::cout << "Using optimal embedding dimensions of previous run"
+                      << std::endl;
+        }
+    } else if (parameters.scheduler == "rma") {
+        // Every rank only sees the columns it processed itself
+        EmbeddingDimMPIMaster embedding_dim_master(df, embedding_tasks, false,
+                                                   MPI_COMM_WORLD);
+        MPIRMAScheduler scheduler(MPI_COMM_WORLD);
+
+        Timer timer_embedding_dim;
+
+        timer_embedding_dim.start();
+
+        if (parameters.kernel_type == "cpu") {
+            EmbeddingDimMPIWorker<EmbeddingDimCPU> embedding_dim_worker(
+                df, parameters.mem_limit, parameters.verbose, MPI_COMM_WORLD);
+
+            scheduler.run(embedding_dim_master, embedding_dim_worker);
+        }
+#ifdef ENABLE_GPU_KERNEL
+        if (parameters.kernel_type == "gpu") {
+            EmbeddingDimMPIWorker<EmbeddingDimGPU> embedding_dim_worker(
+                df, parameters.mem_limit, parameters.verbose, MPI_COMM_WORLD);
+
+            scheduler.run(embedding_dim_master, embedding_dim_worker);
+        }
+#endif
+
+        // Every rank only knows the E of the columns it processed, the
+        // others are zero
+        optimal_E = embedding_dim_master.optimal_E;
+        MPI_Allreduce(MPI_IN_PLACE, optimal_E.data(), optimal_E.size(),
+                      MPI_UINT32_T, MPI_MAX, MPI_COMM_WORLD);
+
+        timer_embedding_dim.stop();
+
+        if (!rank) {
+            dataset_embedding.write(optimal_E);
+
+            std::cout << "Processed optimal E in "
+                      << timer_embedding_dim.elapsed() << " [ms]" << std::endl;
+        }
+    } else if (!rank) {
+        EmbeddingDimMPIMaster embedding_dim_master(df, embedding_tasks, true,
+                                                   MPI_COMM_WORLD);
 
         Timer timer_embedding_dim;
 
-        timer.start();
         timer_embedding_dim.start();
         embedding_dim_master.run();
         timer_embedding_dim.stop();
@@ -219,14 +676,14 @@ void run(int rank, const DataFrame &df, const Parameters &parameters)
     } else {
         if (parameters.kernel_type == "cpu") {
             EmbeddingDimMPIWorker<EmbeddingDimCPU> embedding_dim_worker(
-                df, parameters.verbose, MPI_COMM_WORLD);
+                df, parameters.mem_limit, parameters.verbose, MPI_COMM_WORLD);
 
             embedding_dim_worker.run();
         }
 #ifdef ENABLE_GPU_KERNEL
         if (parameters.kernel_type == "gpu") {
             EmbeddingDimMPIWorker<EmbeddingDimGPU> embedding_dim_worker(
-                df, parameters.verbose, MPI_COMM_WORLD);
+                df, parameters.mem_limit, parameters.verbose, MPI_COMM_WORLD);
 
             embedding_dim_worker.run();
         }
@@ -235,58 +692,195 @@ void run(int rank, const DataFrame &df, const Parameters &parameters)
 
     MPI_Bcast(optimal_E.data(), optimal_E.size(), MPI_FLOAT, 0, MPI_COMM_WORLD);
 
-    const auto dataspace_corrcoef =
-        HighFive::DataSpace({df.n_columns(), df.n_columns()});
-    auto dataset_corrcoef =
-        file.createDataSet<float>("/corrcoef", dataspace_corrcoef);
+    // Either collect the strongest edges or write the dense matrix
+    std::unique_ptr<EdgeCollector> edges;
+    std::unique_ptr<HDF5RowWriter> sink;
+    std::unique_ptr<Checkpoint> checkpoint;
+    std::unique_ptr<CheckpointRowWriter> writer;
+    std::vector<uint8_t> completed(df.n_columns(), 0);
+
+    if (parameters.top_k ||
+        parameters.threshold > -std::numeric_limits<float>::infinity()) {
+        edges.reset(new EdgeCollector(df.n_columns(), parameters.top_k,
+                                      parameters.threshold));
+    } else {
+        auto dataset =
+            file.exist("/corrcoef")
+                ? file.getDataSet("/corrcoef")
+                : create_float_dataset(file, "/corrcoef", df.n_columns(),
+                                       df.n_columns(), parameters.layout);
+
+        if (dataset.getDimensions() !=
+            std::vector<size_t>{df.n_columns(), df.n_columns()}) {
+            throw std::invalid_argument(
+                "Output does not match the input dataset");
+        }
 
-    auto total_io_time = 0.0f;
+        // Flushing is collective, so workers only flag rows. Rows are
+        // written independently before their flags.
+        checkpoint.reset(new Checkpoint(file, df.n_columns()));
+        sink.reset(new HDF5RowWriter(dataset));
+        writer.reset(new CheckpointRowWriter(*sink, *checkpoint, false));
+        completed = checkpoint->completed_flags();
+
+        if (!rank && checkpoint->n_completed()) {
+            std::cout << "Resuming after " << checkpoint->n_completed()
+                      << " of " << df.n_columns() << " completed libraries"
+                      << std::endl;
+        }
+    }
 
-    if (!rank) {
-        CrossMappingMPIMaster cross_mapping_master(df, parameters.chunk_size,
-                                                   MPI_COMM_WORLD);
+    // Collective writes exchange rows in rounds that bound the memory of
+    // aggregators
+    std::unique_ptr<MPIRowAggregator> aggregator;
+    auto round_rows = df.n_columns();
+
+    if (parameters.write_mode == "collective") {
+        const auto n_aggregators = MPIRowAggregator::aggregator_count(
+            parameters.n_aggregators, MPI_COMM_WORLD);
+        const auto alignment =
+            std::max<size_t>(parameters.layout.chunk_rows, 1);
+        const auto row_bytes = df.n_columns() * sizeof(float);
+
+        aggregator.reset(new MPIRowAggregator(*writer, n_aggregators,
+                                              alignment, MPI_COMM_WORLD));
+        round_rows = std::max<size_t>(parameters.io_buffer * n_aggregators /
+                                          row_bytes / alignment,
+                                      1) *
+                     alignment;
+
+        if (!rank) {
+            std::cout << "Writing output through " << n_aggregators
+                      << " aggregators in rounds of " << round_rows
+                      << " rows" << std::endl;
+        }
+    }
+
+    // Workers hand their rows to the aggregator if there is one
+    RowWriter *output = writer.get();
+    if (aggregator) {
+        output = aggregator.get();
+    }
+
+    const auto rounds =
+        plan_rounds(df, completed, parameters, n_workers, round_rows);
+    RunStats stats = {0, 0.0f, 0.0f, 0.0f, std::vector<float>()};
+
+    // Asynchronous writes hand over the rows of a task as one block
+    size_t async_rows = 0;
+    if (parameters.async_io) {
+        for (const auto &round : rounds) {
+            for (const auto &task : round.tasks) {
+                async_rows = std::max(async_rows, task.stop - task.start);
+            }
+        }
+    }
 
-        Timer timer_cross_mapping;
+    if (parameters.scheduler == "rma" || rank) {
+        if (parameters.kernel_type == "cpu") {
+            CrossMappingMPIWorker<CrossMappingCPU> cross_mapping_worker(
+                output, edges.get(), df, optimal_E, parameters.mem_limit,
+                async_rows, parameters.n_threads, parameters.bind,
+                parameters.verbose, MPI_COMM_WORLD);
+
+            run_rounds(rounds, &cross_mapping_worker, aggregator.get(),
+                       parameters.scheduler == "rma", stats);
+            cross_mapping_worker.flush_output();
+
+            stats.io_time += cross_mapping_worker.total_io_time();
+            stats.compute_time = cross_mapping_worker.total_compute_time();
+            stats.background_io_time =
+                cross_mapping_worker.background_io_time();
+        }
+#ifdef ENABLE_GPU_KERNEL
+        if (parameters.kernel_type == "gpu") {
+            CrossMappingMPIWorker<CrossMappingGPU> cross_mapping_worker(
+                output, edges.get(), df, optimal_E, parameters.mem_limit,
+                async_rows, parameters.n_threads, parameters.bind,
+                parameters.verbose, MPI_COMM_WORLD);
+
+            run_rounds(rounds, &cross_mapping_worker, aggregator.get(),
+                       parameters.scheduler == "rma", stats);
+            cross_mapping_worker.flush_output();
+
+            stats.io_time += cross_mapping_worker.total_io_time();
+            stats.compute_time = cross_mapping_worker.total_compute_time();
+            stats.background_io_time =
+                cross_mapping_worker.background_io_time();
+        }
+#endif
+    } else {
+        run_rounds(rounds, nullptr, aggregator.get(), false, stats);
+    }
 
-        timer_cross_mapping.start();
-        cross_mapping_master.run();
-        timer_cross_mapping.stop();
+    if (parameters.scheduler == "rma") {
+        uint64_t min_tasks, max_tasks;
 
+        MPI_Reduce(&stats.n_tasks, &min_tasks, 1, MPI_UINT64_T, MPI_MIN, 0,
+                   MPI_COMM_WORLD);
+        MPI_Reduce(&stats.n_tasks, &max_tasks, 1, MPI_UINT64_T, MPI_MAX, 0,
+                   MPI_COMM_WORLD);
+
+        if (!rank) {
+            std::cout << "Tasks per rank: " << min_tasks << " - " << max_tasks
+                      << std::endl;
+        }
+    }
+
+    if (!rank) {
         timer.stop();
 
         std::cout << "Processed dataset in " << timer.elapsed() << " [ms]"
                   << std::endl;
-    } else {
-        if (parameters.kernel_type == "cpu") {
-            CrossMappingMPIWorker<CrossMappingCPU> cross_mapping_worker(
-                dataset_corrcoef, df, optimal_E, parameters.verbose,
-                MPI_COMM_WORLD);
+    }
+
+    report_runtimes(stats.runtimes, rank, MPI_COMM_WORLD);
+
+    if (edges) {
+        Timer timer_edges;
+        timer_edges.start();
+
+        gather_edges(*edges, rank, MPI_COMM_WORLD);
+
+        // Dataset creation is collective, so every rank needs the size
+        const auto csr = edges->to_csr();
+        uint64_t nnz = csr.indices.size();
+        MPI_Bcast(&nnz, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
 
-            cross_mapping_worker.run();
+        create_edge_datasets(file, df.n_columns(), nnz);
 
-            total_io_time = cross_mapping_worker.total_io_time();
+        if (!rank) {
+            write_edge_list(file, csr);
         }
-#ifdef ENABLE_GPU_KERNEL
-        if (parameters.kernel_type == "gpu") {
-            CrossMappingMPIWorker<CrossMappingGPU> cross_mapping_worker(
-                dataset_corrcoef, df, optimal_E, parameters.verbose,
-                MPI_COMM_WORLD);
 
-            cross_mapping_worker.run();
+        timer_edges.stop();
 
-            total_io_time = cross_mapping_worker.total_io_time();
+        if (!rank) {
+            std::cout << "Merged and wrote " << nnz << " edges in "
+                      << timer_edges.elapsed() << " [ms]" << std::endl;
         }
-#endif
     }
 
-    auto max_io_time = 0.0f;
+    auto max_io_time = 0.0f, max_compute_time = 0.0f,
+         max_background_io_time = 0.0f;
 
-    MPI_Reduce(&total_io_time, &max_io_time, 1, MPI_FLOAT, MPI_MAX, 0,
+    MPI_Reduce(&stats.io_time, &max_io_time, 1, MPI_FLOAT, MPI_MAX, 0,
                MPI_COMM_WORLD);
+    MPI_Reduce(&stats.compute_time, &max_compute_time, 1, MPI_FLOAT, MPI_MAX,
+               0, MPI_COMM_WORLD);
+    MPI_Reduce(&stats.background_io_time, &max_background_io_time, 1,
+               MPI_FLOAT, MPI_MAX, 0, MPI_COMM_WORLD);
 
     if (!rank) {
+        std::cout << "Max compute Time: " << max_compute_time << " [ms]"
+                  << std::endl;
         std::cout << "Max output IO Time: " << max_io_time << " [ms]"
                   << std::endl;
+
+        if (async_rows) {
+            std::cout << "Max background IO Time: " << max_background_io_time
+                      << " [ms]" << std::endl;
+        }
     }
 }
 
@@ -306,6 +900,40 @@ void usage(const std::string &app_name)
         "  -x, --kernel arg     Kernel type {cpu|gpu} (default: cpu)\n"
         "  -d, --dataset arg    HDF5 dataset name\n"
         "  -c, --chunksize arg  Number of timeseries per task (default: 1)\n"
+        "  -j, --workers arg    Threads cross mapping the libraries of a task "
+        "at once,\n"
+        "                       each with at least one library and, with -b, "
+        "its own\n"
+        "                       share of the CPUs (default: 1)\n"
+        "  -C, --e-chunk arg    Minimum number of timeseries per embedding "
+        "dimension\n"
+        "                       task (default: 1)\n"
+        "  -g, --guided         Issue the largest tasks first and shrink "
+        "them as work\n"
+        "                       runs out, down to chunksize\n"
+        "  -s, --scheduler arg  Task distribution {master|rma} (default: "
+        "master)\n"
+        "  -S, --share arg      Load input into node shared memory "
+        "{none|node|bcast}\n"
+        "                       (default: node)\n"
+        "  -W, --write arg      Output writes {independent|collective} "
+        "(default:\n"
+        "                       independent)\n"
+        "  -w, --writers arg    Ranks writing collective output (default: one "
+        "per node)\n"
+        "  -B, --io-buffer arg  Rows buffered per writer and round, e.g. 1G\n"
+        "                       (default: 256M)\n"
+        "  -A, --async-io       Write output from a background thread\n"
+        "  -b, --bind arg       Pin threads {none|compact|scatter}\n"
+        "  -m, --mem-limit arg  Memory budget for k-NN per rank, e.g. 16G, "
+        "split among\n"
+        "                       workers (default: unlimited)\n"
+        "  -k, --chunk-rows arg Rows per output chunk (default: contiguous)\n"
+        "  -q, --quantize arg   Store output as {none|fp16|int8} (default: "
+        "none)\n"
+        "  -K, --top-k arg      Only store the K strongest edges per target\n"
+        "  -T, --threshold arg  Only store edges with rho >= threshold\n"
+        "  -R, --resume         Skip libraries completed by a previous run\n"
         "  -v, --verbose        Enable verbose logging (default: false)\n"
         "  -h, --help           Show help";
 
@@ -315,8 +943,12 @@ void usage(const std::string &app_name)
 int main(int argc, char *argv[])
 {
     argh::parser cmdl({"-t", "--tau", "-p", "--tp", "-e", "--maxe", "-x",
-                       "--kernel", "-d", "--dataset", "-c", "--chunksize", "-v",
-                       "--verbose"});
+                       "--kernel", "-d", "--dataset", "-c", "--chunksize", "-C",
+                       "--e-chunk", "-j", "--workers", "-s", "--scheduler",
+                       "-S", "--share", "-W", "--write", "-w", "--writers",
+                       "-B", "--io-buffer", "-b", "--bind", "-m", "--mem-limit",
+                       "-k", "--chunk-rows", "-q", "--quantize", "-K",
+                       "--top-k", "-T", "--threshold", "-v", "--verbose"});
     cmdl.parse(argc, argv);
 
     if (cmdl[{"-h", "--help"}]) {
@@ -347,9 +979,79 @@ int main(int argc, char *argv[])
     cmdl({"x", "kernel"}, "cpu") >> parameters.kernel_type;
     cmdl({"d", "dataset"}) >> parameters.dataset_name;
     cmdl({"c", "chunksize"}, 1) >> parameters.chunk_size;
+    cmdl({"C", "e-chunk"}, 1) >> parameters.embedding_chunk_size;
+    cmdl({"j", "workers"}, 1) >> parameters.n_threads;
+    parameters.guided = cmdl[{"g", "guided"}];
+    cmdl({"s", "scheduler"}, "master") >> parameters.scheduler;
+    cmdl({"S", "share"}, "node") >> parameters.share_input;
+    cmdl({"W", "write"}, "independent") >> parameters.write_mode;
+    cmdl({"w", "writers"}, 0) >> parameters.n_aggregators;
+    std::string io_buffer;
+    cmdl({"B", "io-buffer"}, "256M") >> io_buffer;
+    parameters.io_buffer = MemoryPlanner::parse_size(io_buffer);
+    parameters.async_io = cmdl[{"A", "async-io"}];
+    cmdl({"b", "bind"}, "none") >> parameters.bind;
+    std::string mem_limit;
+    cmdl({"m", "mem-limit"}, "0") >> mem_limit;
+    parameters.mem_limit = MemoryPlanner::parse_size(mem_limit);
+    cmdl({"k", "chunk-rows"}, 0) >> parameters.layout.chunk_rows;
+    cmdl({"q", "quantize"}, "none") >> parameters.layout.quantization;
+    cmdl({"K", "top-k"}, 0) >> parameters.top_k;
+    std::string threshold;
+    cmdl({"T", "threshold"}) >> threshold;
+    parameters.threshold = threshold.empty()
+                               ? -std::numeric_limits<float>::infinity()
+                               : std::stof(threshold);
+    parameters.resume = cmdl[{"R", "resume"}];
     parameters.verbose = cmdl[{"v", "verbose"}];
 
-    MPI_Init(&argc, &argv);
+    if (parameters.scheduler != "master" && parameters.scheduler != "rma") {
+        std::cerr << "Unknown scheduler " << parameters.scheduler << std::endl;
+        return 1;
+    }
+
+    if (parameters.write_mode != "independent" &&
+        parameters.write_mode != "collective") {
+        std::cerr << "Unknown write mode " << parameters.write_mode
+                  << std::endl;
+        return 1;
+    }
+
+    const auto edge_list =
+        parameters.top_k ||
+        parameters.threshold > -std::numeric_limits<float>::infinity();
+
+    if (parameters.write_mode == "collective" && edge_list) {
+        std::cerr << "Collective writes require dense HDF5 output"
+                  << std::endl;
+        return 1;
+    }
+
+    // Collective writes already return right after buffering rows
+    if (parameters.async_io &&
+        (parameters.write_mode == "collective" || edge_list)) {
+        std::cerr << "Asynchronous writes require independent HDF5 output"
+                  << std::endl;
+        return 1;
+    }
+
+    // Edge lists are only written at the end of a run
+    if (parameters.resume && edge_list) {
+        std::cerr << "Resuming requires dense HDF5 output" << std::endl;
+        return 1;
+    }
+
+    // The background writer calls into MPI-IO while the worker communicates.
+    // Worker threads leave MPI to the main thread.
+    int required = MPI_THREAD_SINGLE;
+    if (parameters.async_io) {
+        required = MPI_THREAD_MULTIPLE;
+    } else if (parameters.n_threads > 1) {
+        required = MPI_THREAD_FUNNELED;
+    }
+
+    int provided;
+    MPI_Init_thread(&argc, &argv, required, &provided);
 
     if (argc < 2) {
         std::cerr << "No input" << std::endl;
@@ -359,37 +1061,71 @@ int main(int argc, char *argv[])
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-    DataFrame df;
-
-    Timer timer_io;
-    timer_io.start();
+    if (parameters.n_threads > 1 && provided < MPI_THREAD_FUNNELED) {
+        if (!rank) {
+            std::cerr << "MPI_THREAD_FUNNELED is not supported" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
-    if (ends_with(parameters.input_fname, ".csv")) {
-        df.load_csv(parameters.input_fname);
-    } else if (ends_with(parameters.input_fname, ".hdf5") ||
-               ends_with(parameters.input_fname, ".h5")) {
-        if (parameters.dataset_name.empty()) {
-            std::cerr << "No HDF5 dataset name" << std::endl;
-            usage(cmdl[0]);
-            return 1;
+    if (parameters.async_io && provided < MPI_THREAD_MULTIPLE) {
+        if (!rank) {
+            std::cerr << "MPI_THREAD_MULTIPLE is not supported, writing "
+                         "output synchronously"
+                      << std::endl;
         }
+        parameters.async_io = false;
+    }
 
-        df.load_hdf5(parameters.input_fname, parameters.dataset_name);
-    } else {
+    pin_threads(parameters.bind);
+
+    const auto is_csv = ends_with(parameters.input_fname, ".csv");
+    const auto is_hdf5 = ends_with(parameters.input_fname, ".hdf5") ||
+                         ends_with(parameters.input_fname, ".h5");
+    const auto is_binary = ends_with(parameters.input_fname, ".mpedm");
+
+    if (is_hdf5 && parameters.dataset_name.empty()) {
+        std::cerr << "No HDF5 dataset name" << std::endl;
+        usage(cmdl[0]);
+        return 1;
+    } else if (!is_csv && !is_hdf5 && !is_binary) {
         std::cerr << "Unknown file type" << std::endl;
         usage(cmdl[0]);
         return 1;
     }
 
-    timer_io.stop();
+    const auto load = [&]() {
+        DataFrame df;
 
-    if (!rank) {
-        std::cout << "Read input dataset (" << df.n_rows() << " rows, "
-                  << df.n_columns() << " columns) in " << timer_io.elapsed()
-                  << " [ms]" << std::endl;
-    }
+        if (is_csv) {
+            df.load_csv(parameters.input_fname);
+        } else if (is_hdf5) {
+            df.load_hdf5(parameters.input_fname, parameters.dataset_name);
+        } else {
+            df.load_binary(parameters.input_fname);
+        }
+
+        return df;
+    };
 
-    run(rank, df, parameters);
+    // The shared input must be released before MPI is finalized
+    {
+        Timer timer_io;
+        timer_io.start();
+
+        const auto df = load_shared_data_frame(load, parameters.share_input,
+                                               MPI_COMM_WORLD);
+
+        timer_io.stop();
+
+        if (!rank) {
+            std::cout << "Read input dataset (" << df.n_rows() << " rows, "
+                      << df.n_columns() << " columns) in "
+                      << timer_io.elapsed() << " [ms]" << std::endl;
+        }
+
+        run(rank, df, parameters);
+    }
 
     MPI_Finalize();
 }
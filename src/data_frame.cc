@@ -2,15 +2,28 @@
 #define __DATASET_HPP__
 
 #include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <fstream>
-#include <sstream>
+#include <limits>
 #include <string>
 #include <vector>
 
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <H5Dpublic.h>
+#include <H5Ppublic.h>
 #include <highfive/H5DataSet.hpp>
 #include <highfive/H5File.hpp>
 
 #include "data_frame.h"
+#include "mapped_file.h"
 
 Series Series::slice(size_t start, size_t end) const
 {
@@ -30,89 +43,606 @@ Series Series::slice(size_t start) const
     return Series(_data + start, _size - start);
 }
 
-void DataFrame::load_csv(const std::string &path)
+// clang-format off
+DataFrame::DataFrame(int n_rows, int n_columns)
+    : _n_rows(n_rows), _n_columns(n_columns), _mapping_offset(0),
+      _external(nullptr)
 {
-    std::ifstream ifs(path);
-    std::string line;
-    // cppcheck-suppress shadowVariable
-    std::vector<std::vector<float>> columns;
+    allocate();
+    create_timeseries();
+}
 
-    if (!ifs) {
-        throw std::invalid_argument("Failed to open file " + path);
+void DataFrame::allocate()
+{
+    // Release the old buffer so that none of its pages are reused
+    uninitialized_vector<float>().swap(_data);
+    _data.resize(_n_rows * _n_columns);
+
+    // First-touch each column from the thread that owns it in a static
+    // column-wise partition so that pages are spread over NUMA nodes
+    #pragma omp parallel for schedule(static)
+    for (auto i = 0u; i < _n_columns; i++) {
+        std::fill(_data.begin() + i * _n_rows,
+                  _data.begin() + (i + 1) * _n_rows, 0.0f);
+    }
+}
+// clang-format on
+
+// Powers of ten that are exactly representable in double precision
+static const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                               1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                               1e18, 1e19, 1e20, 1e21, 1e22};
+
+static bool is_blank(char c) { return c == ' ' || c == '\t'; }
+
+// Parse a float the same way as std::stof. Used for anything the fast path
+// below cannot round exactly (long mantissas, large exponents, inf/nan, ...).
+static bool parse_float_slow(const char *first, const char *last, float &value)
+{
+    const std::string cell(first, last);
+    char *end;
+
+    value = std::strtof(cell.c_str(), &end);
+
+    return end != cell.c_str();
+}
+
+// Locale-independent float parser. Decimal mantissas of up to 19 digits
+// scaled by 10^-22...10^22 are first rounded to double, which is exact up to
+// a single rounding, and then to float. Rounding twice only differs from
+// rounding once when the double lands exactly on the midpoint between two
+// floats, in which case we fall back to strtof.
+static bool parse_float(const char *first, const char *last, float &value)
+{
+    auto p = first;
+
+    while (p < last && is_blank(*p)) {
+        p++;
+    }
+
+    auto negative = false;
+    if (p < last && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    auto n_digits = 0;
+    auto exponent = 0;
+    auto any_digit = false;
+    auto exact = true;
+
+    for (auto fraction = false; p < last; p++) {
+        if (*p == '.' && !fraction) {
+            fraction = true;
+            continue;
+        } else if (*p < '0' || *p > '9') {
+            break;
+        }
+
+        const auto digit = *p - '0';
+        any_digit = true;
+
+        if (mantissa > 0 || digit > 0) {
+            if (n_digits < 19) {
+                mantissa = mantissa * 10 + digit;
+                n_digits++;
+            } else {
+                exact = false;
+            }
+        }
+        if (fraction) {
+            exponent--;
+        }
+    }
+
+    if (any_digit && p < last && (*p == 'e' || *p == 'E')) {
+        auto q = p + 1;
+        auto exp_negative = false;
+        auto exp_value = 0;
+
+        if (q < last && (*q == '-' || *q == '+')) {
+            exp_negative = *q == '-';
+            q++;
+        }
+
+        // Leave "1e" and alike to the slow path
+        if (q < last && *q >= '0' && *q <= '9') {
+            for (; q < last && *q >= '0' && *q <= '9'; q++) {
+                exp_value = std::min(exp_value * 10 + (*q - '0'), 100000);
+            }
+            exponent += exp_negative ? -exp_value : exp_value;
+            p = q;
+        }
+    }
+
+    while (p < last && is_blank(*p)) {
+        p++;
     }
 
+    if (!any_digit || p != last || !exact) {
+        return parse_float_slow(first, last, value);
+    }
+
+    if (mantissa == 0) {
+        value = negative ? -0.0f : 0.0f;
+        return true;
+    }
+
+    if (mantissa >= (1ull << 53) || exponent < -22 || exponent > 22) {
+        return parse_float_slow(first, last, value);
+    }
+
+    const auto d = exponent < 0 ? mantissa / POW10[-exponent]
+                                : mantissa * POW10[exponent];
+    const auto f = static_cast<float>(d);
+
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+
+    // Subnormal or overflowing results, and ties between two floats
+    if (f < std::numeric_limits<float>::min() ||
+        f > std::numeric_limits<float>::max() ||
+        (bits & 0x1fffffff) == 0x10000000) {
+        return parse_float_slow(first, last, value);
+    }
+
+    value = negative ? -f : f;
+
+    return true;
+}
+
+// clang-format off
+void DataFrame::load_csv(const std::string &path)
+{
+    const MappedFile file(path);
+    file.advise_sequential();
+
+    const auto begin = file.data();
+    const auto end = begin + file.size();
+
+    unmap();
+
     _n_rows = 0;
     _n_columns = 0;
 
-    auto is_header = true;
+    // Skip leading empty lines
+    auto header = begin;
+    while (header < end && (*header == '\n' || *header == '\r')) {
+        header++;
+    }
+
+    if (header == end) {
+        _data.clear();
+        create_timeseries();
+        return;
+    }
+
+    auto header_end = static_cast<const char *>(
+        std::memchr(header, '\n', end - header));
+    if (!header_end) {
+        header_end = end;
+    }
+
+    _n_columns = std::count(header, header_end, ',') + 1;
+
+    // Read header
+    auto header_last = header_end;
+    if (header_last > header && header_last[-1] == '\r') {
+        header_last--;
+    }
+    for (auto p = header; names.size() < _n_columns;) {
+        const auto name_end = std::find(p, header_last, ',');
+
+        names.push_back(std::string(p, name_end));
+        p = name_end + 1;
+    }
 
-    while (ifs >> line) {
-        std::stringstream ss(line);
-        std::string cell;
+    // Find row boundaries in parallel. Each block records the rows starting
+    // right after a newline inside it so that no row is found twice.
+    const auto body = std::min(header_end + 1, end);
+    const size_t BLOCK_SIZE = 1 << 20;
+    const auto n_blocks = (end - body + BLOCK_SIZE - 1) / BLOCK_SIZE;
 
-        for (auto i = 0; std::getline(ss, cell, ','); i++) {
-            // Read header
-            if (is_header) {
-                columns.push_back(std::vector<float>());
-                _n_columns++;
-                continue;
+    std::vector<std::vector<const char *>> block_rows(n_blocks);
+
+    #pragma omp parallel for schedule(static)
+    for (auto b = 0u; b < n_blocks; b++) {
+        const auto lo = body + b * BLOCK_SIZE;
+        const auto hi = std::min(lo + BLOCK_SIZE, end);
+        auto &rows = block_rows[b];
+
+        if (b == 0) {
+            rows.push_back(body);
+        }
+
+        for (auto p = lo; p < hi; p++) {
+            p = static_cast<const char *>(std::memchr(p, '\n', hi - p));
+            if (!p) {
+                break;
             }
+            rows.push_back(p + 1);
+        }
 
-            // Read body
-            columns[i].push_back(std::stof(cell));
+        // Drop empty lines
+        rows.erase(std::remove_if(rows.begin(), rows.end(),
+                                  [end](const char *row) {
+                                      return row == end || *row == '\n' ||
+                                             *row == '\r';
+                                  }),
+                   rows.end());
+    }
+
+    std::vector<const char *> rows;
+    for (const auto &r : block_rows) {
+        rows.insert(rows.end(), r.begin(), r.end());
+    }
+
+    _n_rows = rows.size();
+    allocate();
+
+    auto bad_row = std::numeric_limits<size_t>::max();
+
+    // Parse rows in parallel and scatter cells directly into the
+    // column-major buffer. The pages were already placed column-wise by
+    // allocate(), so the scatter does not move them.
+    #pragma omp parallel for schedule(static)
+    for (auto i = 0u; i < _n_rows; i++) {
+        auto line_end = static_cast<const char *>(
+            std::memchr(rows[i], '\n', end - rows[i]));
+        if (!line_end) {
+            line_end = end;
+        }
+        if (line_end > rows[i] && line_end[-1] == '\r') {
+            line_end--;
         }
 
-        if (is_header) {
-            is_header = false;
-            continue;
+        auto p = rows[i];
+        auto ok = true;
+
+        for (auto j = 0u; j < _n_columns && ok; j++) {
+            auto cell_end = static_cast<const char *>(
+                std::memchr(p, ',', line_end - p));
+            if (!cell_end) {
+                cell_end = line_end;
+            }
+
+            float value = 0.0f;
+            ok = parse_float(p, cell_end, value) &&
+                 (j + 1 < _n_columns ? cell_end < line_end
+                                     : cell_end == line_end);
+
+            _data[j * _n_rows + i] = value;
+            p = cell_end + 1;
+        }
+
+        if (!ok) {
+            #pragma omp critical
+            bad_row = std::min<size_t>(bad_row, i);
         }
-        _n_rows++;
     }
 
-    _data.resize(_n_rows * _n_columns);
-    for (auto i = 0u; i < _n_columns; i++) {
-        std::copy(columns[i].begin(), columns[i].end(),
-                  _data.begin() + i * _n_rows);
+    if (bad_row != std::numeric_limits<size_t>::max()) {
+        _data.clear();
+        names.clear();
+        _n_rows = 0;
+        _n_columns = 0;
+        create_timeseries();
+
+        throw std::invalid_argument("Malformed row " +
+                                    std::to_string(bad_row + 1) + " in " +
+                                    path);
     }
 
     create_timeseries();
 }
+// clang-format on
+
+// Number of rows to read from `dataset` at once. Reads cover whole chunks
+// along the row axis and are sized to roughly `target_bytes`. The two read
+// buffers are kept within a small share of the available memory and never
+// exceed the rows of the dataset.
+static size_t hdf5_block_rows(const HighFive::DataSet &dataset,
+                              size_t n_columns, size_t target_bytes)
+{
+    const auto shape = dataset.getDimensions();
+    const auto plist = H5Dget_create_plist(dataset.getId());
+
+    hsize_t chunk[2] = {1, shape[1]};
+    if (plist >= 0 && H5Pget_layout(plist) == H5D_CHUNKED) {
+        H5Pget_chunk(plist, 2, chunk);
+    }
+    if (plist >= 0) {
+        H5Pclose(plist);
+    }
+
+    const long pages = sysconf(_SC_AVPHYS_PAGES);
+    const long page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) {
+        target_bytes = std::min(target_bytes, static_cast<size_t>(pages) *
+                                                  page_size / 16);
+    }
+
+    const size_t chunk_rows = std::max<hsize_t>(chunk[0], 1);
+    const auto row_bytes = std::max<size_t>(n_columns, 1) * sizeof(float);
+    const auto max_rows = std::max<size_t>(target_bytes / row_bytes, 1);
+
+    // Fall back to partial chunks if a single chunk does not fit
+    const auto rows =
+        chunk_rows > max_rows
+            ? max_rows
+            : chunk_rows * std::max<size_t>(max_rows / chunk_rows, 1);
+
+    return std::min<size_t>(rows, shape[0]);
+}
 
 void DataFrame::load_hdf5(const std::string &path, const std::string &ds_name)
 {
     const HighFive::File file(path, HighFive::File::ReadOnly);
     const auto dataset = file.getDataSet(ds_name);
+
+    load_hdf5(dataset, 0, dataset.getDimensions()[1]);
+}
+
+void DataFrame::load_hdf5(const std::string &path, const std::string &ds_name,
+                          size_t col_start, size_t col_stop)
+{
+    const HighFive::File file(path, HighFive::File::ReadOnly);
+    const auto dataset = file.getDataSet(ds_name);
+
+    load_hdf5(dataset, col_start, col_stop);
+}
+
+// clang-format off
+void DataFrame::load_hdf5(const HighFive::DataSet &dataset, size_t col_start,
+                          size_t col_stop)
+{
     const auto shape = dataset.getDimensions();
 
-    _n_rows = shape[0];
-    _n_columns = shape[1];
+    if (shape.size() != 2) {
+        throw std::invalid_argument("Dataset must be two-dimensional");
+    } else if (col_start > col_stop || col_stop > shape[1]) {
+        throw std::invalid_argument("Invalid column range");
+    }
 
-    const size_t MAX_CHUNK_SIZE = 100;
+    unmap();
 
-    std::vector<float> rows(MAX_CHUNK_SIZE * _n_columns);
+    _n_rows = shape[0];
+    _n_columns = col_stop - col_start;
+
+    // The transpose below first-touches the pages
+    uninitialized_vector<float>().swap(_data);
     _data.resize(_n_rows * _n_columns);
 
-    for (auto i = 0u; i < _n_rows; i += MAX_CHUNK_SIZE) {
-        const auto chunk_size = std::min(MAX_CHUNK_SIZE, _n_rows - i);
+    const auto block_rows = hdf5_block_rows(dataset, _n_columns, 16 << 20);
+    const auto n_blocks =
+        block_rows ? (_n_rows + block_rows - 1) / block_rows : 0;
+
+    // Rows of two consecutive blocks (row-major)
+    std::vector<float> buffers[2];
+    buffers[0].resize(block_rows * _n_columns);
+    buffers[1].resize(block_rows * _n_columns);
+
+    const auto read_block = [&](size_t b) {
+        const auto row = b * block_rows;
+        const auto n = std::min(block_rows, _n_rows - row);
+
+        if (n > 0 && _n_columns > 0) {
+            dataset.select({row, col_start}, {n, _n_columns})
+                .read(buffers[b % 2].data());
+        }
+    };
+
+    // Square tiles keep both the source rows and the destination columns
+    // in cache during the transpose
+    const size_t TILE = 64;
+    const auto n_tiles = (_n_columns + TILE - 1) / TILE;
+
+    std::exception_ptr error;
+
+    if (n_blocks > 0) {
+        read_block(0);
+    }
+
+    #pragma omp parallel
+    {
+        #ifdef _OPENMP
+        const size_t tid = omp_get_thread_num();
+        const size_t n_threads = omp_get_num_threads();
+        #else
+        const size_t tid = 0;
+        const size_t n_threads = 1;
+        #endif
+
+        // Thread 0 reads the next block while the other threads transpose
+        // the current one. Each of them owns the same range of tiles in
+        // every block, so all pages of a column are first-touched on one
+        // NUMA node. A single thread reads first and then transposes.
+        size_t t_begin = 0, t_end = 0;
+
+        if (n_threads == 1) {
+            t_end = n_tiles;
+        } else if (tid > 0) {
+            t_begin = (tid - 1) * n_tiles / (n_threads - 1);
+            t_end = tid * n_tiles / (n_threads - 1);
+        }
+
+        for (auto b = 0u; b < n_blocks; b++) {
+            if (tid == 0 && b + 1 < n_blocks && !error) {
+                try {
+                    read_block(b + 1);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            }
+
+            const auto row = b * block_rows;
+            const auto n = std::min(block_rows, _n_rows - row);
+            const auto &rows = buffers[b % 2];
 
-        dataset.select({i, 0}, {chunk_size, _n_columns}).read(rows.data());
+            for (auto t = t_begin; t < t_end; t++) {
+                const auto k_end = std::min((t + 1) * TILE, _n_columns);
 
-        for (auto j = 0u; j < chunk_size; j++) {
-            for (auto k = 0u; k < _n_columns; k++) {
-                _data[k * _n_rows + (i + j)] = rows[j * _n_columns + k];
+                for (auto j0 = 0u; j0 < n; j0 += TILE) {
+                    const auto j_end = std::min(j0 + TILE, n);
+
+                    for (auto k = t * TILE; k < k_end; k++) {
+                        for (auto j = j0; j < j_end; j++) {
+                            _data[k * _n_rows + row + j] =
+                                rows[j * _n_columns + k];
+                        }
+                    }
+                }
             }
+
+            // The next block is read and the current one is transposed
+            #pragma omp barrier
         }
     }
 
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    create_timeseries();
+}
+// clang-format on
+
+// Header of the mpEDM binary format (.mpedm). The header is followed by the
+// column names, each terminated by a NUL character, and the data in
+// column-major order starting at `data_offset`. The data is aligned to a page
+// boundary so that it can be used directly from a memory mapping. All fields
+// are stored in host byte order.
+struct BinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint64_t n_rows;
+    uint64_t n_columns;
+    uint64_t names_size;
+    uint64_t data_offset;
+};
+
+static_assert(sizeof(BinaryHeader) == 48, "BinaryHeader must not be padded");
+
+static const char BINARY_MAGIC[8] = {'M', 'P', 'E', 'D', 'M', 0, 0, 0};
+static const uint32_t BINARY_VERSION = 1;
+static const uint32_t BINARY_DTYPE_FLOAT32 = 0;
+static const uint64_t BINARY_ALIGNMENT = 4096;
+
+void DataFrame::load_binary(const std::string &path)
+{
+    auto mapping = std::make_shared<const MappedFile>(path);
+    BinaryHeader header;
+
+    if (mapping->size() < sizeof(header)) {
+        throw std::invalid_argument("Truncated binary file " + path);
+    }
+
+    std::memcpy(&header, mapping->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC))) {
+        throw std::invalid_argument("Not an mpEDM binary file " + path);
+    } else if (header.version != BINARY_VERSION) {
+        throw std::invalid_argument("Unsupported binary file version " +
+                                    std::to_string(header.version));
+    } else if (header.dtype != BINARY_DTYPE_FLOAT32) {
+        throw std::invalid_argument("Unsupported binary file dtype " +
+                                    std::to_string(header.dtype));
+    } else if (header.data_offset % sizeof(float) ||
+               header.data_offset < sizeof(header) + header.names_size ||
+               header.data_offset > mapping->size() ||
+               (mapping->size() - header.data_offset) / sizeof(float) /
+                       std::max<uint64_t>(header.n_columns, 1) <
+                   header.n_rows) {
+        throw std::invalid_argument("Truncated binary file " + path);
+    }
+
+    std::vector<std::string> new_names;
+    const auto names_begin = mapping->data() + sizeof(header);
+    const auto names_end = names_begin + header.names_size;
+
+    for (auto p = names_begin; p < names_end;) {
+        const auto name_end = std::find(p, names_end, '\0');
+
+        new_names.push_back(std::string(p, name_end));
+        p = name_end + 1;
+    }
+
+    if (!new_names.empty() && new_names.size() != header.n_columns) {
+        throw std::invalid_argument("Wrong number of column names in " +
+                                    path);
+    }
+
+    // Drop the previous data, including external buffers
+    unmap();
+    _data.clear();
+    _data.shrink_to_fit();
+    _n_rows = header.n_rows;
+    _n_columns = header.n_columns;
+    _mapping = mapping;
+    _mapping_offset = header.data_offset;
+    names = new_names;
+
     create_timeseries();
 }
 
+void DataFrame::save_binary(const std::string &path) const
+{
+    std::ofstream ofs(path, std::ios::binary);
+
+    if (!ofs) {
+        throw std::invalid_argument("Failed to open file " + path);
+    }
+
+    std::string names_block;
+    if (names.size() == _n_columns) {
+        for (const auto &name : names) {
+            names_block += name;
+            names_block.push_back('\0');
+        }
+    }
+
+    BinaryHeader header;
+    std::memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.version = BINARY_VERSION;
+    header.dtype = BINARY_DTYPE_FLOAT32;
+    header.n_rows = _n_rows;
+    header.n_columns = _n_columns;
+    header.names_size = names_block.size();
+    header.data_offset = (sizeof(header) + names_block.size() +
+                          BINARY_ALIGNMENT - 1) /
+                         BINARY_ALIGNMENT * BINARY_ALIGNMENT;
+
+    const std::string padding(
+        header.data_offset - sizeof(header) - names_block.size(), '\0');
+
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ofs.write(names_block.data(), names_block.size());
+    ofs.write(padding.data(), padding.size());
+    ofs.write(reinterpret_cast<const char *>(data()), size() * sizeof(float));
+
+    if (!ofs) {
+        throw std::runtime_error("Failed to write file " + path);
+    }
+}
+
 void DataFrame::create_timeseries()
 {
     columns.resize(_n_columns);
     for (auto i = 0u; i < _n_columns; i++) {
-        columns[i] = Series(_data.data() + i * _n_rows, _n_rows);
+        columns[i] = Series(data() + i * _n_rows, _n_rows);
     }
 }
 
+void DataFrame::unmap()
+{
+    _mapping.reset();
+    _mapping_offset = 0;
+    _external = nullptr;
+    _owner.reset();
+    names.clear();
+}
+
 #endif
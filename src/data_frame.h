@@ -1,16 +1,26 @@
 #ifndef __DATAFRAME_H__
 #define __DATAFRAME_H__
 
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "mapped_file.h"
+#include "uninitialized_vector.h"
+
+namespace HighFive
+{
+class DataSet;
+}
+
 class Series
 {
 public:
     Series() : Series(nullptr, 0) {}
     Series(const float *data, size_t size) : _data(data), _size(size) {}
-    explicit Series(const std::vector<float> &vec)
+    template <class Allocator>
+    explicit Series(const std::vector<float, Allocator> &vec)
         : Series(vec.data(), vec.size())
     {
     }
@@ -32,33 +42,108 @@ class DataFrame
 {
 public:
     std::vector<Series> columns;
+    // Column names (empty if the input has none)
+    std::vector<std::string> names;
 
-    DataFrame() : _n_rows(0), _n_columns(0) {}
-    DataFrame(int n_rows, int n_columns)
-        : _n_rows(n_rows), _n_columns(n_columns)
+    DataFrame()
+        : _n_rows(0), _n_columns(0), _mapping_offset(0), _external(nullptr)
     {
-        create_timeseries();
     }
+    DataFrame(int n_rows, int n_columns);
     DataFrame(const std::vector<float> &data, int n_rows, int n_columns)
-        : _data(data), _n_rows(n_rows), _n_columns(n_columns)
+        : _data(data.begin(), data.end()), _n_rows(n_rows),
+          _n_columns(n_columns), _mapping_offset(0), _external(nullptr)
     {
         create_timeseries();
     }
+    // Refer to column-major `data` without copying it, e.g. MPI shared
+    // memory. `owner` is kept alive as long as the DataFrame.
+    DataFrame(const float *data, size_t n_rows, size_t n_columns,
+              const std::shared_ptr<const void> &owner)
+        : _n_rows(n_rows), _n_columns(n_columns), _mapping_offset(0),
+          _external(data), _owner(owner)
+    {
+        create_timeseries();
+    }
+    // Series in the copy refer to the copied data, not to the original. A
+    // copy of a memory-mapped or external DataFrame is held in memory.
+    DataFrame(const DataFrame &other)
+        : names(other.names),
+          _data(other.data(), other.data() + other.size()),
+          _n_rows(other._n_rows), _n_columns(other._n_columns),
+          _mapping_offset(0), _external(nullptr)
+    {
+        create_timeseries();
+    }
+    DataFrame(DataFrame &&other) = default;
 
-    const float *data() const { return _data.data(); }
+    DataFrame &operator=(const DataFrame &other)
+    {
+        if (this == &other) {
+            return *this;
+        }
+
+        names = other.names;
+        _data.assign(other.data(), other.data() + other.size());
+        _n_rows = other._n_rows;
+        _n_columns = other._n_columns;
+        _mapping.reset();
+        _mapping_offset = 0;
+        _external = nullptr;
+        _owner.reset();
+        create_timeseries();
+
+        return *this;
+    }
+    DataFrame &operator=(DataFrame &&other) = default;
+
+    const float *data() const
+    {
+        if (_external) {
+            return _external;
+        }
+
+        return _mapping ? reinterpret_cast<const float *>(_mapping->data() +
+                                                          _mapping_offset)
+                        : _data.data();
+    }
     size_t n_rows() const { return _n_rows; }
     size_t n_columns() const { return _n_columns; }
+    size_t size() const { return _n_rows * _n_columns; }
+    // True if the data is a read-only mapping of a binary file
+    bool is_mapped() const { return static_cast<bool>(_mapping); }
+    const std::shared_ptr<const MappedFile> &mapping() const
+    {
+        return _mapping;
+    }
 
     void load_csv(const std::string &path);
     void load_hdf5(const std::string &path, const std::string &dataset);
+    // Load only columns [col_start, col_stop) of a dataset
+    void load_hdf5(const std::string &path, const std::string &dataset,
+                   size_t col_start, size_t col_stop);
+    // Map a file in the mpEDM binary format without copying its data
+    void load_binary(const std::string &path);
+    void save_binary(const std::string &path) const;
 
 protected:
     // raw data stored in column-major
-    std::vector<float> _data;
+    uninitialized_vector<float> _data;
     size_t _n_rows;
     size_t _n_columns;
+    // File mapping holding the data instead of `_data`
+    std::shared_ptr<const MappedFile> _mapping;
+    size_t _mapping_offset;
+    // Data owned by `_owner` instead of `_data`
+    const float *_external;
+    std::shared_ptr<const void> _owner;
 
     void create_timeseries();
+    // Allocate `_data` for the current shape and first-touch it column-wise
+    void allocate();
+    void load_hdf5(const HighFive::DataSet &dataset, size_t col_start,
+                   size_t col_stop);
+    void unmap();
 };
 
 #endif
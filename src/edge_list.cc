@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include <highfive/H5DataSpace.hpp>
+
+#include "edge_list.h"
+
+typedef std::pair<float, uint32_t> Entry;
+
+EdgeCollector::EdgeCollector(size_t n_targets, size_t top_k, float threshold)
+    : top_k(top_k), threshold(threshold), heaps(n_targets)
+{
+}
+
+void EdgeCollector::add(uint32_t target, float rho, uint32_t library)
+{
+    if (std::isnan(rho) || rho < threshold) {
+        return;
+    }
+
+    auto &heap = heaps[target];
+
+    if (!top_k) {
+        heap.push_back(Entry(rho, library));
+    } else if (heap.size() < top_k) {
+        heap.push_back(Entry(rho, library));
+        std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+    } else if (Entry(rho, library) > heap.front()) {
+        // Replace the weakest edge kept so far
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+        heap.back() = Entry(rho, library);
+        std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+    }
+}
+
+// clang-format off
+void EdgeCollector::add_row(uint32_t library, const std::vector<float> &rhos)
+{
+    #pragma omp parallel for schedule(static)
+    for (auto i = 0u; i < heaps.size(); i++) {
+        add(i, rhos[i], library);
+    }
+}
+// clang-format on
+
+void EdgeCollector::merge(const std::vector<Edge> &edges)
+{
+    for (const auto &edge : edges) {
+        add(edge.target, edge.rho, edge.library);
+    }
+}
+
+std::vector<Edge> EdgeCollector::edges() const
+{
+    const auto csr = to_csr();
+    std::vector<Edge> edges;
+
+    for (auto i = 0u; i < heaps.size(); i++) {
+        for (auto j = csr.indptr[i]; j < csr.indptr[i + 1]; j++) {
+            edges.push_back(Edge{csr.indices[j], i, csr.data[j]});
+        }
+    }
+
+    return edges;
+}
+
+EdgeList EdgeCollector::to_csr() const
+{
+    EdgeList csr;
+    csr.indptr.push_back(0);
+
+    for (const auto &heap : heaps) {
+        auto sorted = heap;
+        std::sort(sorted.begin(), sorted.end(), std::greater<Entry>());
+
+        for (const auto &entry : sorted) {
+            csr.indices.push_back(entry.second);
+            csr.data.push_back(entry.first);
+        }
+
+        csr.indptr.push_back(csr.indices.size());
+    }
+
+    return csr;
+}
+
+void create_edge_datasets(HighFive::File &file, size_t n_targets, size_t nnz)
+{
+    file.createDataSet<uint64_t>("/edge_indptr",
+                                 HighFive::DataSpace({n_targets + 1}));
+    file.createDataSet<uint32_t>("/edge_indices", HighFive::DataSpace({nnz}));
+    file.createDataSet<float>("/edge_data", HighFive::DataSpace({nnz}));
+}
+
+void write_edge_list(HighFive::File &file, const EdgeList &edges)
+{
+    file.getDataSet("/edge_indptr").write(edges.indptr);
+
+    // Zero-sized selections are not allowed
+    if (!edges.indices.empty()) {
+        file.getDataSet("/edge_indices").write(edges.indices);
+        file.getDataSet("/edge_data").write(edges.data);
+    }
+}
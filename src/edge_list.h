@@ -0,0 +1,64 @@
+#ifndef __EDGE_LIST_H__
+#define __EDGE_LIST_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <highfive/H5DataSet.hpp>
+#include <highfive/H5File.hpp>
+
+// Causal edge from a library to a target, weighted by the cross map skill
+struct Edge {
+    uint32_t library;
+    uint32_t target;
+    float rho;
+};
+
+// Edges grouped by target in compressed sparse row format. Edges of target
+// i are indices[indptr[i]:indptr[i + 1]] (libraries) and
+// data[indptr[i]:indptr[i + 1]] (rho), sorted by decreasing rho.
+struct EdgeList {
+    std::vector<uint64_t> indptr;
+    std::vector<uint32_t> indices;
+    std::vector<float> data;
+};
+
+// Keeps the strongest edges of every target while libraries are streamed
+// in. An edge is kept if its rho is at least `threshold` and among the
+// `top_k` largest of its target. `top_k` = 0 keeps all edges above the
+// threshold. Edges with NaN rho are never kept.
+class EdgeCollector
+{
+public:
+    EdgeCollector(size_t n_targets, size_t top_k, float threshold);
+
+    // Add the edges from `library` to every target
+    void add_row(uint32_t library, const std::vector<float> &rhos);
+    // Add edges collected elsewhere, e.g. by another MPI rank
+    void merge(const std::vector<Edge> &edges);
+
+    std::vector<Edge> edges() const;
+    EdgeList to_csr() const;
+
+    size_t n_targets() const { return heaps.size(); }
+
+protected:
+    size_t top_k;
+    float threshold;
+    // Min-heap of (rho, library) per target when top_k > 0, otherwise an
+    // unordered list
+    std::vector<std::vector<std::pair<float, uint32_t>>> heaps;
+
+    void add(uint32_t target, float rho, uint32_t library);
+};
+
+// Create /edge_indptr, /edge_indices and /edge_data for an edge list of
+// `n_targets` targets and `nnz` edges. Collective in parallel HDF5.
+void create_edge_datasets(HighFive::File &file, size_t n_targets, size_t nnz);
+
+// Write `edges` to the datasets created by create_edge_datasets()
+void write_edge_list(HighFive::File &file, const EdgeList &edges);
+
+#endif
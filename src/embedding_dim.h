@@ -2,25 +2,78 @@
 #define __EMBEDDING_DIM_H__
 
 #include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
 
 #include "data_frame.h"
+#include "embedding_search.h"
 
 class EmbeddingDim
 {
 public:
+    // Number of folds that puts every point into a fold of its own
+    static const uint32_t leave_one_out =
+        std::numeric_limits<uint32_t>::max();
+
     EmbeddingDim(uint32_t max_E, uint32_t tau, uint32_t Tp, bool verbose)
-        : max_E(max_E), tau(tau), Tp(Tp), verbose(verbose)
+        : max_E(max_E), tau(tau), Tp(Tp), verbose(verbose), memory_budget(0),
+          n_folds(0), search(max_E)
     {
     }
     virtual ~EmbeddingDim() {}
 
     virtual uint32_t run(const Series &ts) = 0;
 
+    // Find the optimal embedding dimension of every series in `columns`
+    virtual std::vector<uint32_t> run_batch(const std::vector<Series> &columns)
+    {
+        std::vector<uint32_t> optimal_E;
+
+        for (const auto &ts : columns) {
+            optimal_E.push_back(run(ts));
+        }
+
+        return optimal_E;
+    }
+
+    // Limit the memory used by the k-NN scratch space to `bytes`. Zero means
+    // unlimited.
+    void set_memory_budget(size_t bytes) { memory_budget = bytes; }
+
+    // Choose which embedding dimensions are evaluated. See EmbeddingSearch.
+    void set_search_policy(const std::string &policy, uint32_t patience,
+                           uint32_t stride)
+    {
+        search = EmbeddingSearch(max_E, policy, patience, stride);
+    }
+
+    // Select E by cross validation instead of predicting the second half of
+    // a series from the first. The embedded series is split into `n`
+    // contiguous folds and every point is predicted from its neighbors in
+    // the other folds. Zero disables cross validation.
+    void set_folds(uint32_t n)
+    {
+        if (n == 1) {
+            throw std::invalid_argument("Need at least two folds");
+        }
+
+        n_folds = n;
+    }
+
+    // Number of embedding dimensions evaluated by all runs so far, and the
+    // number an exhaustive search would have evaluated
+    size_t n_evaluated() const { return search.n_evaluated(); }
+    size_t n_exhaustive() const { return search.n_exhaustive(); }
+
 protected:
     uint32_t max_E;
     uint32_t tau;
     uint32_t Tp;
     bool verbose;
+    size_t memory_budget;
+    uint32_t n_folds;
+    EmbeddingSearch search;
 };
 
 #endif
@@ -1,26 +1,240 @@
 #include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "embedding_dim_cpu.h"
+#include "memory_planner.h"
 #include "stats.h"
 
 uint32_t EmbeddingDimCPU::run(const Series &ts)
 {
+    workspace.knn->set_memory_budget(memory_budget);
+
+    search.reset();
+
+    for (auto Es = search.next(); !Es.empty(); Es = search.next()) {
+        for (const auto E : Es) {
+            search.report(E, skill(workspace, ts, E, memory_budget));
+        }
+    }
+
+    return search.best_E();
+}
+
+// clang-format off
+std::vector<uint32_t>
+EmbeddingDimCPU::run_batch(const std::vector<Series> &columns)
+{
+#ifdef _OPENMP
+    const auto n_threads = static_cast<size_t>(omp_get_max_threads());
+#else
+    const auto n_threads = static_cast<size_t>(1);
+#endif
+
+    // Every thread runs its own k-NN searches, so the budget is split
+    const auto thread_budget =
+        memory_budget ? std::max<size_t>(memory_budget / n_threads, 1) : 0;
+
+    if (workspaces.size() < n_threads) {
+        workspaces.resize(n_threads);
+    }
+    for (auto &ws : workspaces) {
+        if (!ws.knn) {
+            ws.knn = std::unique_ptr<NearestNeighbors>(
+                new NearestNeighborsCPU(tau, Tp, verbose));
+        }
+        ws.knn->set_memory_budget(thread_budget);
+    }
+    workspace.knn->set_memory_budget(memory_budget);
+
+    // Every column is searched independently with the configured policy
+    std::vector<EmbeddingSearch> searches(columns.size(), search);
+    for (auto &s : searches) {
+        s.reset();
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    std::vector<float> rhos;
+    size_t n_evaluated = 0;
+
+    for (;;) {
+        // Gather the next batch of every column that is still searching
+        pairs.clear();
+        for (auto i = 0u; i < columns.size(); i++) {
+            for (const auto E : searches[i].next()) {
+                pairs.push_back(std::make_pair(i, E));
+            }
+        }
+
+        if (pairs.empty()) {
+            break;
+        }
+
+        rhos.resize(pairs.size());
+
+        if (pairs.size() < n_threads) {
+            // Too few pairs to keep every thread busy, e.g. after the first
+            // round of an early-stopping search. Evaluate them one after
+            // another with the k-NN search parallelized inside as in run().
+            for (auto k = 0u; k < pairs.size(); k++) {
+                rhos[k] = skill(workspace, columns[pairs[k].first],
+                                pairs[k].second, memory_budget);
+            }
+        } else {
+            // Exceptions cannot leave the parallel region, so the first one
+            // is rethrown after it
+            std::exception_ptr error;
+
+            #pragma omp parallel
+            {
+                #ifdef _OPENMP
+                auto &ws = workspaces[omp_get_thread_num()];
+                #else
+                auto &ws = workspaces[0];
+                #endif
+
+                #pragma omp for schedule(dynamic)
+                for (auto k = 0u; k < pairs.size(); k++) {
+                    try {
+                        rhos[k] = skill(ws, columns[pairs[k].first],
+                                        pairs[k].second, thread_budget);
+                    } catch (...) {
+                        #pragma omp critical
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                }
+            }
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        for (auto k = 0u; k < pairs.size(); k++) {
+            searches[pairs[k].first].report(pairs[k].second, rhos[k]);
+        }
+
+        n_evaluated += pairs.size();
+    }
+
+    search.add_counts(n_evaluated, columns.size() * max_E);
+
+    std::vector<uint32_t> optimal_E;
+    for (const auto &s : searches) {
+        optimal_E.push_back(s.best_E());
+    }
+
+    return optimal_E;
+}
+
+float EmbeddingDimCPU::skill(Workspace &ws, const Series &ts, uint32_t E,
+                             size_t budget) const
+{
+    if (n_folds) {
+        return cross_validated_skill(ws, ts, E, budget);
+    }
+
     // Split input into two halves
     const auto library = ts.slice(0, ts.size() / 2);
     const auto target = ts.slice(ts.size() / 2);
 
-    for (auto E = 1u; E <= max_E; E++) {
-        knn->compute_lut(lut, library, target, E, E + 1);
-        lut.normalize();
+    ws.knn->compute_lut(ws.lut, library, target, E, E + 1);
+    ws.lut.normalize();
+
+    const auto prediction = simplex->predict(ws.buffer, ws.lut, library, E);
+    const auto shifted_target = simplex->shift_target(target, E);
+
+    return corrcoef(prediction, shifted_target);
+}
+
+float EmbeddingDimCPU::cross_validated_skill(Workspace &ws, const Series &ts,
+                                             uint32_t E, size_t budget) const
+{
+    const auto shift = (E - 1) * tau + Tp;
+    const auto top_k = E + 1;
+
+    // Points of the embedded series that have a future value
+    const size_t n = ts.size() > shift ? ts.size() - shift : 0;
+    const size_t folds = std::min<size_t>(n_folds, n);
+    const auto p_ts = ts.data();
 
-        const auto prediction = simplex->predict(buffer, lut, library, E);
-        const auto shifted_target = simplex->shift_target(target, E);
+    // Point i belongs to fold i * folds / n. Every point needs top_k
+    // neighbors outside of the largest fold.
+    if (!folds || n - (n + folds - 1) / folds < top_k) {
+        throw std::invalid_argument(
+            "Series too short to cross validate E=" + std::to_string(E));
+    }
+
+    // The distances between all points are computed once and shared by all
+    // folds. Rows are processed in chunks that fit into the memory budget.
+    const auto n_chunk = MemoryPlanner(budget).knn_chunk_rows(n, n, top_k);
+
+    ws.distances.resize(std::min(n_chunk, n) * n);
+    ws.lut.resize(n, top_k);
+
+    for (size_t begin = 0; begin < n; begin += n_chunk) {
+        const auto end = std::min(begin + n_chunk, n);
+
+        #pragma omp parallel for schedule(static)
+        for (auto i = begin; i < end; i++) {
+            const auto row = ws.distances.data() + (i - begin) * n;
+
+            #pragma omp simd
+            for (auto j = 0u; j < n; j++) {
+                row[j] = 0.0f;
+            }
+
+            for (auto k = 0u; k < E; k++) {
+                const float tmp = p_ts[i + k * tau];
 
-        rhos[E - 1] = corrcoef(prediction, shifted_target);
+                #pragma omp simd
+                for (auto j = 0u; j < n; j++) {
+                    auto diff = tmp - p_ts[j + k * tau];
+                    row[j] += diff * diff;
+                }
+            }
+
+            // Mask the points in the fold of point i, including itself
+            const auto fold = i * folds / n;
+            const auto fold_begin = (fold * n + folds - 1) / folds;
+            const auto fold_end = ((fold + 1) * n + folds - 1) / folds;
+
+            for (auto j = fold_begin; j < fold_end; j++) {
+                row[j] = std::numeric_limits<float>::infinity();
+            }
+
+            const auto indices = ws.lut.indices.begin() + i * top_k;
+            const auto distances = ws.lut.distances.begin() + i * top_k;
+
+            std::partial_sort_copy(Counter<uint32_t>(0), Counter<uint32_t>(n),
+                                   indices, indices + top_k,
+                                   [&](uint32_t a, uint32_t b) -> bool {
+                                       return row[a] < row[b];
+                                   });
+
+            // Point j predicts the value shift steps after it
+            for (auto j = 0u; j < top_k; j++) {
+                distances[j] = std::sqrt(row[indices[j]]);
+                indices[j] += shift;
+            }
+        }
     }
 
-    const auto it = std::max_element(rhos.begin(), rhos.end());
-    const auto best_E = it - rhos.begin() + 1;
+    ws.lut.normalize();
+
+    const auto prediction = simplex->predict(ws.buffer, ws.lut, ts, E);
+    const auto shifted_target = simplex->shift_target(ts, E);
 
-    return best_E;
+    return corrcoef(prediction, shifted_target);
 }
+// clang-format on
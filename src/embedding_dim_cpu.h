@@ -13,19 +13,41 @@ class EmbeddingDimCPU : public EmbeddingDim
 public:
     EmbeddingDimCPU(uint32_t max_E, uint32_t tau, uint32_t Tp, bool verbose)
         : EmbeddingDim(max_E, tau, Tp, verbose),
-          knn(new NearestNeighborsCPU(tau, Tp, verbose)),
-          simplex(new SimplexCPU(tau, Tp, verbose)), rhos(max_E)
+          simplex(new SimplexCPU(tau, Tp, verbose))
     {
+        workspace.knn = std::unique_ptr<NearestNeighbors>(
+            new NearestNeighborsCPU(tau, Tp, verbose));
     }
 
     uint32_t run(const Series &ts) override;
 
+    // Evaluate all (column, E) pairs of a search round in parallel. Suited
+    // for many short series where a single k-NN search is too small to keep
+    // all threads busy. Rounds with fewer pairs than threads are evaluated
+    // one pair at a time with parallel k-NN searches instead.
+    std::vector<uint32_t>
+    run_batch(const std::vector<Series> &columns) override;
+
 protected:
-    std::unique_ptr<NearestNeighbors> knn;
+    // Scratch space of run or of a thread in run_batch, kept across calls
+    struct Workspace {
+        std::unique_ptr<NearestNeighbors> knn;
+        LUT lut;
+        scratch_vector<float> buffer;
+        // Rows of the self-distance matrix for cross validation
+        scratch_vector<float> distances;
+    };
+
     std::unique_ptr<Simplex> simplex;
-    LUT lut;
-    std::vector<float> rhos;
-    std::vector<float> buffer;
+    Workspace workspace;
+    std::vector<Workspace> workspaces;
+
+    // Forecast skill of embedding dimension `E` for series `ts`
+    float skill(Workspace &ws, const Series &ts, uint32_t E,
+                size_t budget) const;
+    // Same with every point predicted from the other folds
+    float cross_validated_skill(Workspace &ws, const Series &ts, uint32_t E,
+                                size_t budget) const;
 };
 
 #endif
@@ -1,4 +1,4 @@
-#include <algorithm>
+#include <stdexcept>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -23,6 +23,13 @@ EmbeddingDimGPU::EmbeddingDimGPU(uint32_t max_E, uint32_t tau, uint32_t Tp,
 // clang-format off
 uint32_t EmbeddingDimGPU::run(const Series &ts)
 {
+    std::vector<uint32_t> Es;
+
+    if (n_folds) {
+        throw std::invalid_argument(
+            "Cross validation is not supported by the GPU kernel");
+    }
+
     #pragma omp parallel num_threads(n_devs)
     {
         #ifdef _OPENMP
@@ -37,22 +44,39 @@ uint32_t EmbeddingDimGPU::run(const Series &ts)
         const auto library = ts.slice(0, ts.size() / 2);
         const auto target = ts.slice(ts.size() / 2);
 
-        #pragma omp for schedule(dynamic)
-        for (auto E = 1u; E <= max_E; E++) {
-            knn->compute_lut(luts[dev_id], library, target, E, E + 1);
-            luts[dev_id].normalize();
+        #pragma omp single
+        search.reset();
+
+        for (;;) {
+            // Spread every batch of the search across the devices
+            #pragma omp single
+            Es = search.next();
+
+            if (Es.empty()) {
+                break;
+            }
 
-            const auto prediction =
-                simplex->predict(buffers[dev_id], luts[dev_id], library, E);
-            const auto shifted_target = simplex->shift_target(target, E);
+            #pragma omp for schedule(dynamic)
+            for (auto i = 0u; i < Es.size(); i++) {
+                const auto E = Es[i];
 
-            rhos[E - 1] = corrcoef(prediction, shifted_target);
+                knn->compute_lut(luts[dev_id], library, target, E, E + 1);
+                luts[dev_id].normalize();
+
+                const auto prediction =
+                    simplex->predict(buffers[dev_id], luts[dev_id], library, E);
+                const auto shifted_target = simplex->shift_target(target, E);
+
+                rhos[E - 1] = corrcoef(prediction, shifted_target);
+            }
+
+            #pragma omp single
+            for (const auto E : Es) {
+                search.report(E, rhos[E - 1]);
+            }
         }
     }
 
-    const auto it = std::max_element(rhos.begin(), rhos.end());
-    const auto best_E = it - rhos.begin() + 1;
-
-    return best_E;
+    return search.best_E();
 }
 // clang-format on
@@ -20,7 +20,7 @@ protected:
     std::unique_ptr<Simplex> simplex;
     std::vector<LUT> luts;
     std::vector<float> rhos;
-    std::vector<std::vector<float>> buffers;
+    std::vector<scratch_vector<float>> buffers;
     uint32_t n_devs;
 };
 
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "embedding_search.h"
+
+EmbeddingSearch::EmbeddingSearch(uint32_t max_E, const std::string &policy,
+                                 uint32_t patience, uint32_t stride)
+    : max_E(max_E), policy(policy), patience(patience), stride(stride),
+      round(0), last_E(0), best(1), best_rho(0), found(false), evaluated(0),
+      exhaustive(0)
+{
+    if (policy != "exhaustive" && policy != "patience" && policy != "coarse") {
+        throw std::invalid_argument("Unknown search policy " + policy);
+    }
+    if (policy == "patience" && !patience) {
+        throw std::invalid_argument("Patience must be at least 1");
+    }
+    if (policy == "coarse" && !stride) {
+        throw std::invalid_argument("Stride must be at least 1");
+    }
+}
+
+void EmbeddingSearch::reset()
+{
+    round = 0;
+    last_E = 0;
+    best = 1;
+    best_rho = 0;
+    found = false;
+    exhaustive += max_E;
+}
+
+std::vector<uint32_t> EmbeddingSearch::next()
+{
+    std::vector<uint32_t> Es;
+
+    if (policy == "exhaustive") {
+        if (!round) {
+            for (auto E = 1u; E <= max_E; E++) {
+                Es.push_back(E);
+            }
+        }
+    } else if (policy == "patience") {
+        if (last_E < max_E && (!last_E || last_E - best < patience)) {
+            Es.push_back(last_E + 1);
+        }
+    } else if (!round) {
+        // Coarse grid including both ends of the range
+        for (auto E = 1u; E <= max_E; E += stride) {
+            Es.push_back(E);
+        }
+        if (max_E && Es.back() != max_E) {
+            Es.push_back(max_E);
+        }
+    } else if (round == 1) {
+        // Refine around the best point of the grid, skipping grid points
+        const auto lo = best > stride ? best - stride + 1 : 1;
+        const auto hi = std::min(best + stride - 1, max_E);
+
+        for (auto E = lo; E <= hi; E++) {
+            if ((E - 1) % stride && E != max_E) {
+                Es.push_back(E);
+            }
+        }
+    }
+
+    if (!Es.empty()) {
+        last_E = std::max(last_E, Es.back());
+    }
+
+    round++;
+    evaluated += Es.size();
+
+    return Es;
+}
+
+void EmbeddingSearch::report(uint32_t E, float rho)
+{
+    if (!found || rho > best_rho || (rho == best_rho && E < best)) {
+        best = E;
+        best_rho = rho;
+        found = true;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef __EMBEDDING_SEARCH_H__
+#define __EMBEDDING_SEARCH_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decides which embedding dimensions from 1 to max_E to evaluate when
+// looking for the one with the highest forecast skill. The kernel asks for
+// batches of E with next(), evaluates them in any order and reports each rho
+// back before asking for the next batch. `policy` is one of:
+//   exhaustive: evaluate every E (reference for validation)
+//   patience:   evaluate E = 1, 2, ... and stop once rho has not improved
+//               for `patience` consecutive E
+//   coarse:     evaluate every `stride`-th E, then every E within `stride`
+//               of the best one
+// Ties are broken towards the smaller E as in the exhaustive search.
+class EmbeddingSearch
+{
+public:
+    explicit EmbeddingSearch(uint32_t max_E,
+                             const std::string &policy = "exhaustive",
+                             uint32_t patience = 3, uint32_t stride = 4);
+
+    // Start a new search. Evaluation counts are kept.
+    void reset();
+
+    // Next batch of embedding dimensions to evaluate. Empty once the search
+    // is finished.
+    std::vector<uint32_t> next();
+
+    // Report the skill of embedding dimension `E`
+    void report(uint32_t E, float rho);
+
+    // Best embedding dimension among those evaluated so far
+    uint32_t best_E() const { return best; }
+
+    // Number of embedding dimensions evaluated by all searches so far
+    size_t n_evaluated() const { return evaluated; }
+    // Number an exhaustive search would have evaluated instead
+    size_t n_exhaustive() const { return exhaustive; }
+
+    // Count evaluations done by copies of this search
+    void add_counts(size_t n_evaluated, size_t n_exhaustive)
+    {
+        evaluated += n_evaluated;
+        exhaustive += n_exhaustive;
+    }
+
+protected:
+    uint32_t max_E;
+    std::string policy;
+    uint32_t patience;
+    uint32_t stride;
+    // Number of batches handed out in the current search
+    uint32_t round;
+    // Largest E handed out in the current search
+    uint32_t last_E;
+    uint32_t best;
+    float best_rho;
+    bool found;
+    size_t evaluated;
+    size_t exhaustive;
+};
+
+#endif
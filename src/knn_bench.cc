@@ -20,16 +20,19 @@
 #define LIKWID_MARKER_GET(regionTag, nevents, events, time, count)
 #endif
 
+#include "affinity.h"
+#include "memory_planner.h"
 #include "nearest_neighbors.h"
 #include "nearest_neighbors_cpu.h"
 #ifdef ENABLE_GPU_KERNEL
 #include "nearest_neighbors_gpu.h"
 #endif
 #include "timer.h"
+#include "uninitialized_vector.h"
 
 template <class T>
 void run_common(uint32_t L, uint32_t E, uint32_t tau, uint32_t iterations,
-                bool verbose)
+                size_t mem_limit, bool verbose)
 {
     LIKWID_MARKER_INIT;
 #pragma omp parallel
@@ -42,6 +45,8 @@ void run_common(uint32_t L, uint32_t E, uint32_t tau, uint32_t iterations,
 
     auto kernel = std::unique_ptr<NearestNeighbors>(new T(tau, 1, verbose));
 
+    kernel->set_memory_budget(mem_limit);
+
     std::vector<float> library_vec(L);
     std::vector<float> target_vec(L);
 
@@ -83,6 +88,10 @@ void run_common(uint32_t L, uint32_t E, uint32_t tau, uint32_t iterations,
     std::cout << "partial_sort " << kernel->timer_sorting.elapsed() / iterations
               << std::endl;
 
+    if (verbose) {
+        ScratchArena::print_stats(std::cout);
+    }
+
     LIKWID_MARKER_CLOSE;
 }
 
@@ -101,6 +110,10 @@ void usage(const std::string &app_name)
         "  -t, --tau arg           Time delay (default: 1)\n"
         "  -i, --iteration arg     Number of iterations (default: 10)\n"
         "  -x, --kernel arg        Kernel type {cpu|gpu} (default: cpu)\n"
+        "  -b, --bind arg          Pin threads {none|compact|scatter}\n"
+        "  -m, --mem-limit arg     Memory budget, e.g. 16G (default: "
+        "unlimited)\n"
+        "  -H, --huge-pages        Back scratch buffers with huge pages\n"
         "  -v, --verbose           Enable verbose logging (default: false)\n"
         "  -h, --help              Show this help";
 
@@ -110,8 +123,8 @@ void usage(const std::string &app_name)
 int main(int argc, char *argv[])
 {
     argh::parser cmdl({"-e", "--embedding-dim", "-l", "--length", "-t", "--tau",
-                       "-i", "--iteration", "-x", "--kernel", "-v",
-                       "--verbose"});
+                       "-i", "--iteration", "-x", "--kernel", "-b", "--bind",
+                       "-m", "--mem-limit", "-v", "--verbose"});
     cmdl.parse(argc, argv);
 
     if (cmdl[{"-h", "--help"}]) {
@@ -129,8 +142,16 @@ int main(int argc, char *argv[])
     cmdl({"i", "iteration"}, 10) >> iterations;
     std::string kernel_type;
     cmdl({"x", "kernel"}, "cpu") >> kernel_type;
+    std::string bind;
+    cmdl({"b", "bind"}, "none") >> bind;
+    std::string mem_limit_str;
+    cmdl({"m", "mem-limit"}, "0") >> mem_limit_str;
+    const auto mem_limit = MemoryPlanner::parse_size(mem_limit_str);
     bool verbose = cmdl[{"v", "verbose"}];
 
+    ScratchArena::set_huge_pages(cmdl[{"H", "huge-pages"}]);
+    pin_threads(bind);
+
     if (L - (E - 1) * tau <= 0) {
         std::cerr << "E or tau is too large" << std::endl;
         return 1;
@@ -139,13 +160,15 @@ int main(int argc, char *argv[])
     if (kernel_type == "cpu") {
         std::cout << "Using CPU kNN kernel" << std::endl;
 
-        run_common<NearestNeighborsCPU>(L, E, tau, iterations, verbose);
+        run_common<NearestNeighborsCPU>(L, E, tau, iterations, mem_limit,
+                                        verbose);
     }
 #ifdef ENABLE_GPU_KERNEL
     else if (kernel_type == "gpu") {
         std::cout << "Using GPU kNN kernel" << std::endl;
 
-        run_common<NearestNeighborsGPU>(L, E, tau, iterations, verbose);
+        run_common<NearestNeighborsGPU>(L, E, tau, iterations, mem_limit,
+                                        verbose);
     }
 #endif
     else {
@@ -16,6 +16,7 @@
 #define LIKWID_MARKER_GET(regionTag, nevents, events, time, count)
 #endif
 
+#include "affinity.h"
 #include "data_frame.h"
 #include "nearest_neighbors_cpu.h"
 #ifdef ENABLE_GPU_KERNEL
@@ -24,6 +25,7 @@
 #include "simplex_cpu.h"
 #include "stats.h"
 #include "timer.h"
+#include "uninitialized_vector.h"
 
 void usage(const std::string &app_name)
 {
@@ -41,6 +43,8 @@ void usage(const std::string &app_name)
         "  -t, --tau arg            Lag (default: 1)\n"
         "  -i, --iteration arg      Number of iterations (default: 10)\n"
         "  -x, --kernel arg         Kernel type {cpu|gpu} (default: cpu)\n"
+        "  -b, --bind arg           Pin threads {none|compact|scatter}\n"
+        "  -H, --huge-pages         Back scratch buffers with huge pages\n"
         "  -v, --verbose            Enable verbose logging (default: false)\n"
         "  -h, --help               Show help";
 
@@ -51,7 +55,7 @@ int main(int argc, char *argv[])
 {
     argh::parser cmdl({"-n", "--num-ts", "-l", "--length", "-e",
                        "--embedding-dim", "-t", "--tau", "-i", "--iteration",
-                       "-x", "--kernel", "-v", "--verbose"});
+                       "-x", "--kernel", "-b", "--bind", "-v", "--verbose"});
     cmdl.parse(argc, argv);
 
     if (cmdl[{"-h", "--help"}]) {
@@ -71,8 +75,13 @@ int main(int argc, char *argv[])
     cmdl({"i", "iteration"}, 10) >> iterations;
     std::string kernel_type;
     cmdl({"x", "kernel"}, "cpu") >> kernel_type;
+    std::string bind;
+    cmdl({"b", "bind"}, "none") >> bind;
     bool verbose = cmdl[{"v", "verbose"}];
 
+    ScratchArena::set_huge_pages(cmdl[{"H", "huge-pages"}]);
+    pin_threads(bind);
+
     uninitialized_vector<float> input(L * N);
     uninitialized_vector<float> output(L * N);
 
@@ -162,5 +171,9 @@ int main(int argc, char *argv[])
 
     std::cout << "lookup: " << t.elapsed() / iterations << std::endl;
 
+    if (verbose) {
+        ScratchArena::print_stats(std::cout);
+    }
+
     return 0;
 }
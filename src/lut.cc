@@ -12,6 +12,15 @@ void LUT::resize(uint32_t nr, uint32_t nc)
     indices.resize(nr * nc);
 }
 
+// Free the memory held by the lookup table
+void LUT::release()
+{
+    _n_rows = 0;
+    _n_columns = 0;
+    distances = scratch_vector<float>();
+    indices = scratch_vector<uint32_t>();
+}
+
 // cppcheck-suppress unusedFunction
 void LUT::print_distances() const
 {
@@ -16,22 +16,23 @@ public:
     {
     }
     LUT(uint32_t n_rows, uint32_t n_columns,
-        const uninitialized_vector<float> &distances,
-        const uninitialized_vector<uint32_t> &indices)
+        const scratch_vector<float> &distances,
+        const scratch_vector<uint32_t> &indices)
         : distances(distances), indices(indices), _n_rows(n_rows),
           _n_columns(n_columns)
     {
     }
 
     // Eucledian distance between point i and j
-    uninitialized_vector<float> distances;
+    scratch_vector<float> distances;
     // Index of the j-th closest point from point i
-    uninitialized_vector<uint32_t> indices;
+    scratch_vector<uint32_t> indices;
 
     uint32_t n_rows() const { return _n_rows; }
     uint32_t n_columns() const { return _n_columns; }
 
     void resize(uint32_t nr, uint32_t nc);
+    void release();
     void print_distances() const;
     void print_indices() const;
     void normalize();
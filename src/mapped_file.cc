@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+MappedFile::MappedFile(const std::string &path) : _data(nullptr), _size(0)
+{
+    const auto fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        throw std::invalid_argument("Failed to open file " + path);
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw std::invalid_argument("Failed to stat file " + path);
+    }
+
+    _size = st.st_size;
+
+    // mmap does not accept empty mappings
+    if (_size > 0) {
+        const auto addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::invalid_argument("Failed to map file " + path);
+        }
+
+        _data = static_cast<const char *>(addr);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data) {
+        munmap(const_cast<char *>(_data), _size);
+    }
+}
+
+void MappedFile::advise_sequential() const
+{
+    if (_data) {
+        madvise(const_cast<char *>(_data), _size, MADV_SEQUENTIAL);
+    }
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+    if (!_data || offset >= _size) {
+        return;
+    }
+
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const auto first = offset / page * page;
+    const auto last = std::min(offset + length, _size);
+
+    madvise(const_cast<char *>(_data) + first, last - first, MADV_WILLNEED);
+}
+
+void MappedFile::evict(size_t offset, size_t length) const
+{
+    if (!_data || offset >= _size) {
+        return;
+    }
+
+    // Only drop pages that lie entirely within the range
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const auto first = (offset + page - 1) / page * page;
+    const auto last = std::min(offset + length, _size) / page * page;
+
+    if (first < last) {
+        madvise(const_cast<char *>(_data) + first, last - first,
+                MADV_DONTNEED);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping is released when the
+// object is destroyed.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return _data; }
+    size_t size() const { return _size; }
+
+    // Hint the kernel that the file will be read front to back
+    void advise_sequential() const;
+    // Start reading the given byte range in the background
+    void prefetch(size_t offset, size_t length) const;
+    // Drop the pages of the given byte range from this process. They are
+    // read again from the file when accessed.
+    void evict(size_t offset, size_t length) const;
+
+protected:
+    const char *_data;
+    size_t _size;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+#include "memory_planner.h"
+
+size_t MemoryPlanner::lut_bytes(size_t n_rows, size_t top_k)
+{
+    return n_rows * top_k * (sizeof(float) + sizeof(uint32_t));
+}
+
+size_t MemoryPlanner::distance_bytes(size_t n_rows, size_t n_library)
+{
+    return n_rows * n_library * sizeof(float);
+}
+
+size_t MemoryPlanner::knn_chunk_rows(size_t n_target, size_t n_library,
+                                     size_t top_k) const
+{
+    const auto out_bytes = lut_bytes(n_target, top_k);
+    const auto row_bytes = distance_bytes(1, n_library);
+
+    if (!budget || !row_bytes) {
+        return std::max<size_t>(n_target, 1);
+    } else if (budget <= out_bytes + row_bytes) {
+        return 1;
+    }
+
+    return std::max<size_t>(
+        std::min(n_target, (budget - out_bytes) / row_bytes), 1);
+}
+
+std::vector<std::vector<uint32_t>>
+MemoryPlanner::lut_groups(const std::vector<uint32_t> &Es, size_t L,
+                          uint32_t tau, uint32_t Tp) const
+{
+    std::vector<std::vector<uint32_t>> groups;
+    size_t group_bytes = 0;
+
+    for (const auto E : Es) {
+        // Lookup table of a library onto itself
+        const auto shift = (E - 1) * tau + Tp;
+        const auto n_library = L > shift ? L - shift : 0;
+        const auto bytes =
+            lut_bytes(n_library + Tp, E + 1) + distance_bytes(1, n_library);
+
+        if (groups.empty() || (budget && group_bytes + bytes > budget)) {
+            groups.push_back(std::vector<uint32_t>());
+            group_bytes = 0;
+        }
+
+        groups.back().push_back(E);
+        group_bytes += lut_bytes(n_library + Tp, E + 1);
+    }
+
+    return groups;
+}
+
+size_t MemoryPlanner::parse_size(const std::string &str)
+{
+    size_t pos = 0;
+    const auto value = std::stod(str, &pos);
+    auto multiplier = 1.0;
+
+    if (pos < str.size()) {
+        switch (std::toupper(str[pos])) {
+        case 'K':
+            multiplier = 1024.0;
+            break;
+        case 'M':
+            multiplier = 1024.0 * 1024;
+            break;
+        case 'G':
+            multiplier = 1024.0 * 1024 * 1024;
+            break;
+        case 'T':
+            multiplier = 1024.0 * 1024 * 1024 * 1024;
+            break;
+        default:
+            throw std::invalid_argument("Invalid size " + str);
+        }
+    }
+
+    if (value < 0) {
+        throw std::invalid_argument("Invalid size " + str);
+    }
+
+    return static_cast<size_t>(value * multiplier);
+}
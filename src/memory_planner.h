@@ -0,0 +1,45 @@
+#ifndef __MEMORY_PLANNER_H__
+#define __MEMORY_PLANNER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Estimates the memory footprint of the k-NN and cross mapping phases and
+// splits them into chunks that fit into a byte budget. Chunking only changes
+// the order in which rows are processed, not the results. A budget of zero
+// means unlimited.
+class MemoryPlanner
+{
+public:
+    explicit MemoryPlanner(size_t budget) : budget(budget) {}
+
+    // Size of a lookup table with `n_rows` rows and `top_k` neighbors
+    static size_t lut_bytes(size_t n_rows, size_t top_k);
+
+    // Size of the distance matrix between `n_rows` target points and
+    // `n_library` library points
+    static size_t distance_bytes(size_t n_rows, size_t n_library);
+
+    // Number of target rows to process at once so that the output lookup
+    // table and one chunk of the distance matrix fit into the budget. Always
+    // at least one row.
+    size_t knn_chunk_rows(size_t n_target, size_t n_library,
+                          size_t top_k) const;
+
+    // Split the embedding dimensions `Es` into groups whose lookup tables of
+    // a library of length `L` fit into the budget together with at least one
+    // row of the distance matrix. Every group holds at least one E.
+    std::vector<std::vector<uint32_t>>
+    lut_groups(const std::vector<uint32_t> &Es, size_t L, uint32_t tau,
+               uint32_t Tp) const;
+
+    // Parse a size such as "512M" or "16G" (binary units, case-insensitive)
+    static size_t parse_size(const std::string &str);
+
+protected:
+    size_t budget;
+};
+
+#endif
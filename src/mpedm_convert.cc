@@ -0,0 +1,92 @@
+#include <iostream>
+
+#include <argh.h>
+
+#include "data_frame.h"
+#include "timer.h"
+
+bool ends_with(const std::string &str, const std::string &suffix)
+{
+    if (str.size() < suffix.size()) {
+        return false;
+    }
+    return str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void usage(const std::string &app_name)
+{
+    const std::string msg =
+        app_name +
+        ": Convert CSV/HDF5 input to the mpEDM binary format\n"
+        "\n"
+        "Usage:\n"
+        "  " +
+        app_name +
+        " [OPTION...] INPUT OUTPUT\n"
+        "  -d, --dataset arg    HDF5 dataset name\n"
+        "  -h, --help           Show help";
+
+    std::cout << msg << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    argh::parser cmdl({"-d", "--dataset"});
+    cmdl.parse(argc, argv);
+
+    if (cmdl[{"-h", "--help"}]) {
+        usage(cmdl[0]);
+        return 0;
+    }
+
+    if (!cmdl(1)) {
+        std::cerr << "No input file" << std::endl;
+        usage(cmdl[0]);
+        return 1;
+    }
+
+    if (!cmdl(2)) {
+        std::cerr << "No output file" << std::endl;
+        usage(cmdl[0]);
+        return 1;
+    }
+
+    std::string input_fname = cmdl[1];
+    std::string output_fname = cmdl[2];
+
+    std::string dataset_name;
+    cmdl({"d", "dataset"}) >> dataset_name;
+
+    Timer timer;
+    timer.start();
+
+    DataFrame df;
+
+    if (ends_with(input_fname, ".csv")) {
+        df.load_csv(input_fname);
+    } else if (ends_with(input_fname, ".hdf5") ||
+               ends_with(input_fname, ".h5")) {
+        if (dataset_name.empty()) {
+            std::cerr << "No HDF5 dataset name" << std::endl;
+            usage(cmdl[0]);
+            return 1;
+        }
+
+        df.load_hdf5(input_fname, dataset_name);
+    } else if (ends_with(input_fname, ".mpedm")) {
+        df.load_binary(input_fname);
+    } else {
+        std::cerr << "Unknown file type" << std::endl;
+        usage(cmdl[0]);
+        return 1;
+    }
+
+    df.save_binary(output_fname);
+
+    timer.stop();
+
+    std::cout << "Converted " << df.n_rows() << " rows, " << df.n_columns()
+              << " columns in " << timer.elapsed() << " [ms]" << std::endl;
+
+    return 0;
+}
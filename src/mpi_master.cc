@@ -7,9 +7,12 @@
 // clang-format off
 void MPIMaster::run()
 {
-    nlohmann::json task;
+    MPITask task;
     MPI_Status stat;
     int comm_size;
+    // Tasks sent whose result has not been received yet. Workers ask for
+    // their next task before returning the result of the current one.
+    size_t pending = 0;
 
     MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
 
@@ -25,7 +28,7 @@ void MPIMaster::run()
     #pragma omp parallel
     {
         #pragma omp master
-        while (task_left() || !workers.empty()) {
+        while (task_left() || !workers.empty() || pending) {
             // Wait for any incomming message
             MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &stat);
 
@@ -47,15 +50,32 @@ void MPIMaster::run()
                 }
 
                 next_task(task);
-                const auto send_buf = nlohmann::json::to_cbor(task);
+                const auto send_buf = encode_message(task);
+
+                if (mpi_json_protocol()) {
+                    std::cerr << "Sending task to rank " << worker << ": "
+                              << nlohmann::json(task).dump() << std::endl;
+                }
 
                 MPI_Send(send_buf.data(), send_buf.size(), MPI_BYTE, worker,
                          TAG_TASK_DATA, comm);
+                pending++;
             }
             // Worker sent result
             else if (stat.MPI_TAG == TAG_RESULT) {
-                #pragma omp task firstprivate(recv_buf)
-                task_done(nlohmann::json::from_cbor(recv_buf));
+                const auto result =
+                    decode_message<MPIResult>(recv_buf.data(), count);
+
+                if (mpi_json_protocol()) {
+                    std::cerr << "Received result from rank " << worker
+                              << ": " << nlohmann::json(result).dump()
+                              << std::endl;
+                }
+
+                pending--;
+
+                #pragma omp task firstprivate(result)
+                task_done(result);
             }
         }
     }
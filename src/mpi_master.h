@@ -4,9 +4,10 @@
 #include <unordered_set>
 
 #include <mpi.h>
-#include <nlohmann/json.hpp>
 
-class MPIMaster
+#include "mpi_task.h"
+
+class MPIMaster : public TaskMaster
 {
 public:
     MPIMaster(MPI_Comm comm) : comm(comm) {}
@@ -17,10 +18,6 @@ public:
 protected:
     MPI_Comm comm;
     std::unordered_set<int> workers;
-
-    virtual void next_task(nlohmann::json &task) = 0;
-    virtual bool task_left() const = 0;
-    virtual void task_done(const nlohmann::json &result){};
 };
 
 #endif
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <vector>
+
+#include "mpi_rma_scheduler.h"
+#include "timer.h"
+
+void MPIRMAScheduler::run(TaskMaster &master, TaskWorker &worker)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    // Tasks are generated in the same order on every rank, so a task id
+    // means the same task everywhere
+    std::vector<MPITask> tasks;
+
+    while (master.task_left()) {
+        MPITask task;
+        master.next_task(task);
+        tasks.push_back(task);
+    }
+
+    // Only rank 0 exposes the counter of the next unclaimed task
+    uint64_t *counter;
+    MPI_Win win;
+
+    MPI_Win_allocate(rank ? 0 : sizeof(uint64_t), sizeof(uint64_t),
+                     MPI_INFO_NULL, comm, &counter, &win);
+
+    if (!rank) {
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, win);
+        *counter = 0;
+        MPI_Win_unlock(0, win);
+    }
+
+    MPI_Barrier(comm);
+
+    local_tasks = 0;
+
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+
+    while (true) {
+        uint64_t first;
+
+        MPI_Fetch_and_op(&claim_size, &first, MPI_UINT64_T, 0, 0, MPI_SUM,
+                         win);
+        MPI_Win_flush(0, win);
+
+        if (first >= tasks.size()) {
+            break;
+        }
+
+        const auto last =
+            std::min<uint64_t>(first + claim_size, tasks.size());
+
+        for (auto id = first; id < last; id++) {
+            MPIResult result = MPIResult();
+            Timer timer;
+
+            timer.start();
+            worker.do_task(result, tasks[id]);
+            result.elapsed = timer.stop();
+            master.task_done(result);
+
+            local_tasks++;
+        }
+    }
+
+    MPI_Win_unlock_all(win);
+
+    MPI_Win_free(&win);
+}
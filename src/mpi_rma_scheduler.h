@@ -0,0 +1,37 @@
+#ifndef __MPI_RMA_SCHEDULER_H__
+#define __MPI_RMA_SCHEDULER_H__
+
+#include <cstdint>
+
+#include <mpi.h>
+
+#include "mpi_master.h"
+#include "mpi_worker.h"
+
+// Distributes the tasks of a TaskMaster without a dedicated master rank.
+// Every rank, including rank 0, holds an identical master and enumerates
+// its tasks. Ranks then claim the next `claim_size` task ids with
+// MPI_Fetch_and_op on a counter exposed by rank 0 and run them with their
+// own worker. task_done() is called on the rank that ran the task, so
+// results needed everywhere must be reduced afterwards.
+class MPIRMAScheduler
+{
+public:
+    MPIRMAScheduler(MPI_Comm comm, uint64_t claim_size = 1)
+        : comm(comm), claim_size(claim_size), local_tasks(0)
+    {
+    }
+
+    // Collective over `comm`
+    void run(TaskMaster &master, TaskWorker &worker);
+
+    // Number of tasks run by this rank in the last call to run()
+    uint64_t n_local_tasks() const { return local_tasks; }
+
+protected:
+    MPI_Comm comm;
+    uint64_t claim_size;
+    uint64_t local_tasks;
+};
+
+#endif
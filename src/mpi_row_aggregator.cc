@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "mpi_row_aggregator.h"
+
+MPIRowAggregator::MPIRowAggregator(RowWriter &sink, int n_aggregators,
+                                   size_t alignment, MPI_Comm comm)
+    : RowWriter(sink.n_columns()), sink(sink), n_aggregators(n_aggregators),
+      alignment(std::max<size_t>(alignment, 1)), comm(comm)
+{
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    if (n_aggregators < 1 || n_aggregators > size) {
+        throw std::invalid_argument("Invalid number of aggregators");
+    }
+}
+
+void MPIRowAggregator::write_rows(size_t start, size_t n_rows,
+                                  const float *rows)
+{
+    for (size_t i = 0; i < n_rows; i++) {
+        ids.push_back(start + i);
+    }
+    values.insert(values.end(), rows, rows + n_rows * _n_columns);
+}
+
+int MPIRowAggregator::aggregator_rank(int i) const
+{
+    return static_cast<int>(static_cast<int64_t>(i) * size / n_aggregators);
+}
+
+void MPIRowAggregator::exchange(size_t start, size_t stop)
+{
+    // Rows owned by each aggregator, rounded up to the alignment
+    const auto per_aggregator =
+        (stop - start + n_aggregators - 1) / n_aggregators;
+    const auto block =
+        std::max<size_t>((per_aggregator + alignment - 1) / alignment, 1) *
+        alignment;
+
+    std::vector<int> dest(ids.size());
+    std::vector<int> send_counts(size, 0);
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (ids[i] < start || ids[i] >= stop) {
+            throw std::invalid_argument("Row outside of the exchanged range");
+        }
+
+        const auto owner = std::min<size_t>((ids[i] - start) / block,
+                                            n_aggregators - 1);
+        dest[i] = aggregator_rank(owner);
+        send_counts[dest[i]]++;
+    }
+
+    // Order buffered rows by destination rank
+    std::vector<size_t> order(ids.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return dest[a] < dest[b]; });
+
+    std::vector<uint64_t> send_ids(ids.size());
+    std::vector<float> send_values(values.size());
+
+    for (size_t i = 0; i < order.size(); i++) {
+        send_ids[i] = ids[order[i]];
+        std::copy(values.begin() + order[i] * _n_columns,
+                  values.begin() + (order[i] + 1) * _n_columns,
+                  send_values.begin() + i * _n_columns);
+    }
+
+    ids.clear();
+    values.clear();
+
+    std::vector<int> recv_counts(size);
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1,
+                 MPI_INT, comm);
+
+    std::vector<int> send_displs(size, 0), recv_displs(size, 0);
+    for (auto i = 1; i < size; i++) {
+        send_displs[i] = send_displs[i - 1] + send_counts[i - 1];
+        recv_displs[i] = recv_displs[i - 1] + recv_counts[i - 1];
+    }
+    const auto n_recv = recv_displs[size - 1] + recv_counts[size - 1];
+
+    std::vector<uint64_t> recv_ids(n_recv);
+    std::vector<float> recv_values(n_recv * _n_columns);
+
+    // Rows are sent as a whole so that counts stay within the range of int
+    MPI_Datatype row_type;
+    MPI_Type_contiguous(_n_columns, MPI_FLOAT, &row_type);
+    MPI_Type_commit(&row_type);
+
+    MPI_Alltoallv(send_ids.data(), send_counts.data(), send_displs.data(),
+                  MPI_UINT64_T, recv_ids.data(), recv_counts.data(),
+                  recv_displs.data(), MPI_UINT64_T, comm);
+    MPI_Alltoallv(send_values.data(), send_counts.data(), send_displs.data(),
+                  row_type, recv_values.data(), recv_counts.data(),
+                  recv_displs.data(), row_type, comm);
+
+    MPI_Type_free(&row_type);
+
+    if (!n_recv) {
+        return;
+    }
+
+    // Write runs of consecutive rows. Rows completed by an earlier run are
+    // missing from the block.
+    order.resize(n_recv);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return recv_ids[a] < recv_ids[b];
+    });
+
+    std::vector<float> rows;
+
+    for (size_t i = 0; i < order.size();) {
+        const auto first = recv_ids[order[i]];
+        auto j = i;
+        rows.clear();
+
+        while (j < order.size() && recv_ids[order[j]] == first + (j - i)) {
+            rows.insert(rows.end(),
+                        recv_values.begin() + order[j] * _n_columns,
+                        recv_values.begin() + (order[j] + 1) * _n_columns);
+            j++;
+        }
+
+        sink.write_rows(first, j - i, rows.data());
+        i = j;
+    }
+}
+
+int MPIRowAggregator::aggregator_count(int n_aggregators, MPI_Comm comm)
+{
+    if (n_aggregators) {
+        return n_aggregators;
+    }
+
+    int rank;
+    MPI_Comm node_comm;
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                        &node_comm);
+    MPI_Comm_rank(node_comm, &rank);
+
+    auto n_nodes = rank ? 0 : 1;
+    MPI_Allreduce(MPI_IN_PLACE, &n_nodes, 1, MPI_INT, MPI_SUM, comm);
+
+    MPI_Comm_free(&node_comm);
+
+    return n_nodes;
+}
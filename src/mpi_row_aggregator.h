@@ -0,0 +1,53 @@
+#ifndef __MPI_ROW_AGGREGATOR_H__
+#define __MPI_ROW_AGGREGATOR_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <mpi.h>
+
+#include "row_writer.h"
+
+// Two-phase output of rows computed by many MPI ranks. Rows written to the
+// aggregator are only buffered. exchange() sends them to a few aggregator
+// ranks, each of which owns a contiguous block of rows and writes it to its
+// sink in as few, large writes as possible. This replaces many small
+// uncoordinated writes with a handful of large ones, like the collective
+// buffering of MPI-IO, and works for any assignment of rows to ranks.
+class MPIRowAggregator : public RowWriter
+{
+public:
+    // `n_aggregators` ranks spread evenly over `comm` write to `sink`. The
+    // blocks owned by aggregators start at multiples of `alignment` rows,
+    // e.g. the chunk size of the output.
+    MPIRowAggregator(RowWriter &sink, int n_aggregators, size_t alignment,
+                     MPI_Comm comm);
+
+    void write_rows(size_t start, size_t n_rows, const float *rows) override;
+
+    // Write the rows buffered by all ranks, which must lie in
+    // [start, stop). Collective over `comm`.
+    void exchange(size_t start, size_t stop);
+
+    // Number of aggregator ranks in `comm`, one per node if `n_aggregators`
+    // is zero. Collective over `comm`.
+    static int aggregator_count(int n_aggregators, MPI_Comm comm);
+
+protected:
+    RowWriter &sink;
+    int n_aggregators;
+    size_t alignment;
+    MPI_Comm comm;
+    int rank;
+    int size;
+
+    // Rows buffered since the last exchange
+    std::vector<uint64_t> ids;
+    std::vector<float> values;
+
+    // Rank of aggregator `i`
+    int aggregator_rank(int i) const;
+};
+
+#endif
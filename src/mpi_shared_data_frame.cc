@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+#include "mpi_shared_data_frame.h"
+
+// Shared-memory window of a node, freed when the last DataFrame referring to
+// it is destroyed
+class SharedWindow
+{
+public:
+    SharedWindow(size_t size, bool leader, MPI_Comm node_comm)
+        : node_comm(node_comm), data(nullptr)
+    {
+        MPI_Win_allocate_shared(leader ? size * sizeof(float) : 0,
+                                sizeof(float), MPI_INFO_NULL, node_comm,
+                                &data, &win);
+
+        // Every rank refers to the memory of the leader
+        if (!leader) {
+            MPI_Aint bytes;
+            int disp_unit;
+            MPI_Win_shared_query(win, 0, &bytes, &disp_unit, &data);
+        }
+    }
+    ~SharedWindow()
+    {
+        MPI_Win_free(&win);
+        MPI_Comm_free(&node_comm);
+    }
+
+    SharedWindow(const SharedWindow &) = delete;
+    SharedWindow &operator=(const SharedWindow &) = delete;
+
+    float *data_ptr() const { return data; }
+    MPI_Win window() const { return win; }
+
+protected:
+    MPI_Comm node_comm;
+    MPI_Win win;
+    float *data;
+};
+
+// Broadcast `count` floats, which may exceed the range of int
+static void bcast_floats(float *data, size_t count, MPI_Comm comm)
+{
+    const size_t max_count = std::numeric_limits<int>::max();
+
+    for (size_t offset = 0; offset < count; offset += max_count) {
+        MPI_Bcast(data + offset, std::min(max_count, count - offset),
+                  MPI_FLOAT, 0, comm);
+    }
+}
+
+// clang-format off
+// Copy column-major `src` into `dst`, or zero `dst` if `src` is null, in a
+// static column-wise partition as in DataFrame so that the pages of every
+// column are first-touched by the thread that owns it
+static void fill_columns(float *dst, const float *src, size_t n_rows,
+                         size_t n_columns)
+{
+    #pragma omp parallel for schedule(static)
+    for (auto i = 0u; i < n_columns; i++) {
+        if (src) {
+            std::copy(src + i * n_rows, src + (i + 1) * n_rows,
+                      dst + i * n_rows);
+        } else {
+            std::fill(dst + i * n_rows, dst + (i + 1) * n_rows, 0.0f);
+        }
+    }
+}
+// clang-format on
+
+DataFrame load_shared_data_frame(const std::function<DataFrame()> &load,
+                                 const std::string &mode, MPI_Comm comm)
+{
+    if (mode == "none") {
+        return load();
+    } else if (mode != "node" && mode != "bcast") {
+        throw std::invalid_argument("Unknown input sharing mode " + mode);
+    }
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    // Ranks sharing memory, led by their lowest rank
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL,
+                        &node_comm);
+
+    int node_rank;
+    MPI_Comm_rank(node_comm, &node_rank);
+
+    const auto leader = node_rank == 0;
+
+    // Node leaders, including rank 0
+    MPI_Comm leader_comm;
+    MPI_Comm_split(comm, leader ? 0 : MPI_UNDEFINED, rank, &leader_comm);
+
+    DataFrame local;
+    uint64_t shape[2] = {0, 0};
+    std::exception_ptr error;
+
+    if (mode == "node" ? leader : rank == 0) {
+        try {
+            local = load();
+            shape[0] = local.n_rows();
+            shape[1] = local.n_columns();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+
+    // Fail on every rank if any of the ranks loading the input failed
+    int failed = error ? 1 : 0;
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, comm);
+
+    if (failed) {
+        if (leader_comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&leader_comm);
+        }
+        MPI_Comm_free(&node_comm);
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        throw std::runtime_error("Failed to load the input on another rank");
+    }
+
+    if (mode == "bcast" && leader) {
+        MPI_Bcast(shape, 2, MPI_UINT64_T, 0, leader_comm);
+    }
+    MPI_Bcast(shape, 2, MPI_UINT64_T, 0, node_comm);
+
+    const auto size = shape[0] * shape[1];
+    const auto window =
+        std::make_shared<SharedWindow>(size, leader, node_comm);
+
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, window->window());
+
+    if (leader) {
+        // Place the pages of the window like those of a DataFrame
+        fill_columns(window->data_ptr(),
+                     mode == "node" || rank == 0 ? local.data() : nullptr,
+                     shape[0], shape[1]);
+
+        // Release the private copy before the other nodes are filled
+        local = DataFrame();
+
+        if (mode == "bcast") {
+            bcast_floats(window->data_ptr(), size, leader_comm);
+        }
+    }
+
+    // Make the data written by the leader visible to the node
+    MPI_Win_sync(window->window());
+    MPI_Barrier(node_comm);
+    MPI_Win_sync(window->window());
+
+    MPI_Win_unlock_all(window->window());
+
+    if (leader_comm != MPI_COMM_NULL) {
+        MPI_Comm_free(&leader_comm);
+    }
+
+    return DataFrame(window->data_ptr(), shape[0], shape[1], window);
+}
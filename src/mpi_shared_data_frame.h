@@ -0,0 +1,24 @@
+#ifndef __MPI_SHARED_DATA_FRAME_H__
+#define __MPI_SHARED_DATA_FRAME_H__
+
+#include <functional>
+#include <string>
+
+#include <mpi.h>
+
+#include "data_frame.h"
+
+// Load the input of an MPI run with `load`, sharing it among ranks
+// according to `mode`:
+//   none:  every rank loads its own copy
+//   node:  the first rank of every node loads the input into an MPI-3
+//          shared-memory window that all ranks of the node refer to
+//   bcast: rank 0 loads the input and broadcasts it into the window of
+//          every node
+// Collective over `comm`. The returned DataFrame refers to the window
+// without copying it. It frees the window when destroyed, which is
+// collective over the node and must happen before MPI_Finalize.
+DataFrame load_shared_data_frame(const std::function<DataFrame()> &load,
+                                 const std::string &mode, MPI_Comm comm);
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef __MPI_TASK_H__
+#define __MPI_TASK_H__
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "task.h"
+
+// Tasks and results exchanged between MPI ranks
+typedef Task MPITask;
+typedef TaskResult MPIResult;
+
+// Largest encoded task. Results have no size limit since their size is
+// probed before they are received.
+const int MPI_MAX_MESSAGE_SIZE = 1024;
+
+// Tasks and results are exchanged as raw bytes, which assumes that all
+// ranks share the same architecture. Setting MPEDM_JSON_PROTOCOL=1 sends
+// them as JSON text instead and logs them to stderr, for debugging.
+inline bool mpi_json_protocol()
+{
+    static const bool enabled = [] {
+        const auto value = std::getenv("MPEDM_JSON_PROTOCOL");
+        return value && std::strcmp(value, "0") != 0;
+    }();
+
+    return enabled;
+}
+
+inline void to_json(nlohmann::json &j, const MPITask &task)
+{
+    j = nlohmann::json{{"start", task.start}, {"stop", task.stop}};
+}
+
+inline void from_json(const nlohmann::json &j, MPITask &task)
+{
+    task.start = j.at("start");
+    task.stop = j.at("stop");
+}
+
+inline void to_json(nlohmann::json &j, const MPIResult &result)
+{
+    j = nlohmann::json{{"start", result.start},
+                       {"stop", result.stop},
+                       {"elapsed", result.elapsed},
+                       {"E", result.E},
+                       {"rho", result.rho}};
+}
+
+inline void from_json(const nlohmann::json &j, MPIResult &result)
+{
+    result.start = j.at("start");
+    result.stop = j.at("stop");
+    result.elapsed = j.at("elapsed");
+    result.E = j.at("E").get<std::vector<uint32_t>>();
+    result.rho = j.at("rho").get<std::vector<float>>();
+}
+
+template <class T> std::vector<uint8_t> encode_message(const T &message)
+{
+    if (mpi_json_protocol()) {
+        const auto text = nlohmann::json(message).dump();
+        return std::vector<uint8_t>(text.begin(), text.end());
+    }
+
+    const auto bytes = reinterpret_cast<const uint8_t *>(&message);
+    return std::vector<uint8_t>(bytes, bytes + sizeof(T));
+}
+
+template <class T> T decode_message(const uint8_t *data, size_t size)
+{
+    if (mpi_json_protocol()) {
+        return nlohmann::json::parse(data, data + size).get<T>();
+    }
+
+    if (size != sizeof(T)) {
+        throw std::runtime_error("Malformed MPI message");
+    }
+
+    T message;
+    std::memcpy(&message, data, sizeof(T));
+
+    return message;
+}
+
+// Results are encoded as their start, stop, the sizes of E and rho and
+// elapsed, followed by the values of E and rho
+template <> inline std::vector<uint8_t> encode_message(const MPIResult &result)
+{
+    if (mpi_json_protocol()) {
+        const auto text = nlohmann::json(result).dump();
+        return std::vector<uint8_t>(text.begin(), text.end());
+    }
+
+    const uint64_t header[] = {result.start, result.stop, result.E.size(),
+                               result.rho.size()};
+    const auto E_bytes = result.E.size() * sizeof(uint32_t);
+    const auto rho_bytes = result.rho.size() * sizeof(float);
+
+    std::vector<uint8_t> message(sizeof(header) + sizeof(float) + E_bytes +
+                                 rho_bytes);
+    auto p = message.data();
+
+    std::memcpy(p, header, sizeof(header));
+    p += sizeof(header);
+    std::memcpy(p, &result.elapsed, sizeof(float));
+    p += sizeof(float);
+    std::memcpy(p, result.E.data(), E_bytes);
+    p += E_bytes;
+    std::memcpy(p, result.rho.data(), rho_bytes);
+
+    return message;
+}
+
+template <>
+inline MPIResult decode_message<MPIResult>(const uint8_t *data, size_t size)
+{
+    if (mpi_json_protocol()) {
+        return nlohmann::json::parse(data, data + size).get<MPIResult>();
+    }
+
+    uint64_t header[4];
+
+    if (size < sizeof(header) + sizeof(float)) {
+        throw std::runtime_error("Malformed MPI message");
+    }
+
+    std::memcpy(header, data, sizeof(header));
+    data += sizeof(header);
+
+    const auto E_bytes = header[2] * sizeof(uint32_t);
+    const auto rho_bytes = header[3] * sizeof(float);
+
+    if (size != sizeof(header) + sizeof(float) + E_bytes + rho_bytes) {
+        throw std::runtime_error("Malformed MPI message");
+    }
+
+    MPIResult result;
+    result.start = header[0];
+    result.stop = header[1];
+    std::memcpy(&result.elapsed, data, sizeof(float));
+    data += sizeof(float);
+
+    result.E.resize(header[2]);
+    result.rho.resize(header[3]);
+    std::memcpy(result.E.data(), data, E_bytes);
+    data += E_bytes;
+    std::memcpy(result.rho.data(), data, rho_bytes);
+
+    return result;
+}
+
+#endif
@@ -1,44 +1,61 @@
 #include <iostream>
+#include <vector>
 
 #include "mpi_common.h"
 #include "mpi_worker.h"
+#include "timer.h"
 
 // Based on https://github.com/nepda/pi-pp/blob/master/serie_4
 void MPIWorker::run()
 {
+    // Buffers of the task being processed and of the next one
+    std::vector<uint8_t> current(MPI_MAX_MESSAGE_SIZE);
+    std::vector<uint8_t> next(MPI_MAX_MESSAGE_SIZE);
+    MPI_Request request;
     MPI_Status stat;
 
-    while (true) {
-        // Here we send a message to the master asking for a task
-        MPI_Send(nullptr, 0, MPI_BYTE, 0, TAG_ASK_FOR_TASK, comm);
+    // Here we send a message to the master asking for a task
+    MPI_Send(nullptr, 0, MPI_BYTE, 0, TAG_ASK_FOR_TASK, comm);
+    MPI_Irecv(next.data(), next.size(), MPI_BYTE, 0, MPI_ANY_TAG, comm,
+              &request);
 
+    while (true) {
         // Wait for a reply from master
-        MPI_Probe(0, MPI_ANY_TAG, comm, &stat);
+        MPI_Wait(&request, &stat);
 
-        // We got a task
-        if (stat.MPI_TAG == TAG_TASK_DATA) {
-            auto count = 0;
-            MPI_Get_count(&stat, MPI_BYTE, &count);
+        // We got a stop message
+        if (stat.MPI_TAG == TAG_STOP) {
+            break;
+        }
 
-            std::vector<uint8_t> recv_buf(count);
+        auto count = 0;
+        MPI_Get_count(&stat, MPI_BYTE, &count);
 
-            // Retrieve task data from master into msg_buffer
-            MPI_Recv(recv_buf.data(), count, MPI_BYTE, 0, TAG_TASK_DATA, comm,
-                     &stat);
+        std::swap(current, next);
+        const auto task = decode_message<MPITask>(current.data(), count);
 
-            // Work on task
-            nlohmann::json result;
-            do_task(result, nlohmann::json::from_cbor(recv_buf));
+        if (mpi_json_protocol()) {
+            std::cerr << "Received task " << nlohmann::json(task).dump()
+                      << std::endl;
+        }
 
-            // Send result to master
-            const auto send_buf = nlohmann::json::to_cbor(result);
-            MPI_Send(send_buf.data(), send_buf.size(), MPI_BYTE, 0, TAG_RESULT,
-                     comm);
+        // Ask for the next task already, so that it arrives while we work
+        // on this one
+        MPI_Send(nullptr, 0, MPI_BYTE, 0, TAG_ASK_FOR_TASK, comm);
+        MPI_Irecv(next.data(), next.size(), MPI_BYTE, 0, MPI_ANY_TAG, comm,
+                  &request);
 
-            // We got a stop message
-        } else if (stat.MPI_TAG == TAG_STOP) {
-            MPI_Recv(nullptr, 0, MPI_BYTE, 0, TAG_STOP, comm, &stat);
-            break;
-        }
+        // Work on task
+        MPIResult result = MPIResult();
+        Timer timer;
+
+        timer.start();
+        do_task(result, task);
+        result.elapsed = timer.stop();
+
+        // Send result to master
+        const auto send_buf = encode_message(result);
+        MPI_Send(send_buf.data(), send_buf.size(), MPI_BYTE, 0, TAG_RESULT,
+                 comm);
     }
 }
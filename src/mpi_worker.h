@@ -2,9 +2,10 @@
 #define __MPI_WORKER_H__
 
 #include <mpi.h>
-#include <nlohmann/json.hpp>
 
-class MPIWorker
+#include "mpi_task.h"
+
+class MPIWorker : public TaskWorker
 {
 public:
     MPIWorker(MPI_Comm comm) : comm(comm) {}
@@ -14,9 +15,6 @@ public:
 
 protected:
     MPI_Comm comm;
-
-    virtual void do_task(nlohmann::json &result,
-                         const nlohmann::json &task) = 0;
 };
 
 #endif
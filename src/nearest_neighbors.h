@@ -14,11 +14,15 @@ public:
     Timer timer_sorting;
 
     NearestNeighbors(uint32_t tau, uint32_t Tp, bool verbose)
-        : tau(tau), Tp(Tp), verbose(verbose)
+        : tau(tau), Tp(Tp), verbose(verbose), memory_budget(0)
     {
     }
     virtual ~NearestNeighbors(){};
 
+    // Limit the memory used by compute_lut (distance matrix and output LUT)
+    // to `bytes`. Zero means unlimited.
+    void set_memory_budget(size_t bytes) { memory_budget = bytes; }
+
     virtual void compute_lut(LUT &out, const Series &library,
                              const Series &target, uint32_t E)
     {
@@ -36,6 +40,8 @@ protected:
     const uint32_t Tp;
     // Enable verbose logging
     const bool verbose;
+    // Maximum memory in bytes (zero for unlimited)
+    size_t memory_budget;
 };
 
 #endif
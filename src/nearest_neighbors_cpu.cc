@@ -17,6 +17,7 @@
 #define LIKWID_MARKER_GET(regionTag, nevents, events, time, count)
 #endif
 
+#include "memory_planner.h"
 #include "nearest_neighbors_cpu.h"
 
 NearestNeighborsCPU::NearestNeighborsCPU(uint32_t tau, uint32_t Tp,
@@ -37,91 +38,105 @@ void NearestNeighborsCPU::compute_lut(LUT &out, const Series &library,
     const auto p_library = library.data();
     const auto p_target = target.data();
 
+    // Process target rows in chunks so that the distance matrix fits into
+    // the memory budget
+    const auto n_chunk = MemoryPlanner(memory_budget)
+                             .knn_chunk_rows(n_target, n_library, top_k);
+
     // Allocate temporary buffer for distance matrix
-    distances.resize(n_target * n_library);
+    distances.resize(std::min(n_chunk, n_target) * n_library);
 
-    timer_distances.start();
+    // Allocate buffer in LUT
+    out.resize(n_target, top_k);
 
-    // Compute distances between all library and target points
-    #pragma omp parallel
-    {
-        LIKWID_MARKER_START("calc_distances");
-    }
+    for (size_t begin = 0; begin < n_target; begin += n_chunk) {
+        const auto end = std::min(begin + n_chunk, n_target);
+
+        timer_distances.start();
 
-    #pragma omp parallel for
-    for (auto i = 0u; i < n_target; i++) {
-        #pragma omp simd
-        for (auto j = 0u; j < n_library; j++) {
-            distances[i * n_library + j] = 0.0f;
+        // Compute distances between all library and target points
+        #pragma omp parallel
+        {
+            LIKWID_MARKER_START("calc_distances");
         }
 
-        for (auto k = 0u; k < E; k++) {
-            const float tmp = p_target[i + k * tau];
+        // All loops over target rows use the same static partition so that
+        // rows of the distance matrix and LUT stay on the NUMA node of the
+        // thread that first touched them
+        #pragma omp parallel for schedule(static)
+        for (auto i = begin; i < end; i++) {
+            const auto row = distances.data() + (i - begin) * n_library;
 
             #pragma omp simd
             for (auto j = 0u; j < n_library; j++) {
-                // Perform embedding on-the-fly
-                auto diff = tmp - p_library[j + k * tau];
-                distances[i * n_library + j] += diff * diff;
+                row[j] = 0.0f;
+            }
+
+            for (auto k = 0u; k < E; k++) {
+                const float tmp = p_target[i + k * tau];
+
+                #pragma omp simd
+                for (auto j = 0u; j < n_library; j++) {
+                    // Perform embedding on-the-fly
+                    auto diff = tmp - p_library[j + k * tau];
+                    row[j] += diff * diff;
+                }
             }
         }
-    }
 
-    #pragma omp parallel
-    {
-        LIKWID_MARKER_STOP("calc_distances");
-    }
+        #pragma omp parallel
+        {
+            LIKWID_MARKER_STOP("calc_distances");
+        }
 
-    // Ignore degenerate neighbors
-    #pragma omp parallel for
-    for (auto i = 0u; i < n_target; i++) {
-        for (auto j = 0u; j < n_library; j++) {
-            if (p_target + i == p_library + j) {
-                distances[i * n_library + j] =
-                    std::numeric_limits<float>::infinity();
+        // Ignore degenerate neighbors
+        #pragma omp parallel for schedule(static)
+        for (auto i = begin; i < end; i++) {
+            for (auto j = 0u; j < n_library; j++) {
+                if (p_target + i == p_library + j) {
+                    distances[(i - begin) * n_library + j] =
+                        std::numeric_limits<float>::infinity();
+                }
             }
         }
-    }
 
-    timer_distances.stop();
+        timer_distances.stop();
 
-    // Allocate buffer in LUT
-    out.resize(n_target, top_k);
+        timer_sorting.start();
 
-    timer_sorting.start();
-
-    // Sort indices
-    #pragma omp parallel
-    {
-        LIKWID_MARKER_START("partial_sort");
-
-        #pragma omp for
-        for (auto i = 0u; i < n_target; i++) {
-            std::partial_sort_copy(Counter<uint32_t>(0),
-                                   Counter<uint32_t>(n_library),
-                                   out.indices.begin() + i * top_k,
-                                   out.indices.begin() + (i + 1) * top_k,
-                                   [&](uint32_t a, uint32_t b) -> uint32_t {
-                                       return distances[i * n_library + a] <
-                                              distances[i * n_library + b];
-                                   });
-        }
+        // Sort indices
+        #pragma omp parallel
+        {
+            LIKWID_MARKER_START("partial_sort");
 
-        LIKWID_MARKER_STOP("partial_sort");
-    }
+            #pragma omp for schedule(static)
+            for (auto i = begin; i < end; i++) {
+                const auto row = distances.data() + (i - begin) * n_library;
 
-    timer_sorting.stop();
+                std::partial_sort_copy(Counter<uint32_t>(0),
+                                       Counter<uint32_t>(n_library),
+                                       out.indices.begin() + i * top_k,
+                                       out.indices.begin() + (i + 1) * top_k,
+                                       [&](uint32_t a, uint32_t b) -> uint32_t {
+                                           return row[a] < row[b];
+                                       });
+            }
 
-    // Compute L2 norms from SSDs and reorder them to match the indices
-    // Shift indices
-    #pragma omp parallel for
-    for (auto i = 0u; i < n_target; i++) {
-        for (auto j = 0u; j < top_k; j++) {
-            auto idx = out.indices[i * top_k + j];
-            out.distances[i * top_k + j] =
-                std::sqrt(distances[i * n_library + idx]);
-            out.indices[i * top_k + j] = idx + shift;
+            LIKWID_MARKER_STOP("partial_sort");
+        }
 
+        timer_sorting.stop();
+
+        // Compute L2 norms from SSDs and reorder them to match the indices
+        // Shift indices
+        #pragma omp parallel for schedule(static)
+        for (auto i = begin; i < end; i++) {
+            for (auto j = 0u; j < top_k; j++) {
+                auto idx = out.indices[i * top_k + j];
+                out.distances[i * top_k + j] =
+                    std::sqrt(distances[(i - begin) * n_library + idx]);
+                out.indices[i * top_k + j] = idx + shift;
+            }
         }
     }
 }
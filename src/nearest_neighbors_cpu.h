@@ -14,7 +14,7 @@ public:
                      uint32_t E, uint32_t top_k) override;
 
 protected:
-    uninitialized_vector<float> distances;
+    scratch_vector<float> distances;
 };
 
 template <class T> class Counter
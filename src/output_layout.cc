@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <H5Apublic.h>
+#include <H5Dpublic.h>
+#include <H5Lpublic.h>
+#include <H5Ppublic.h>
+#include <H5Spublic.h>
+#include <H5Tpublic.h>
+
+#include "output_layout.h"
+
+size_t OutputLayout::effective_chunk_rows(size_t n_columns) const
+{
+    if (chunk_rows || !compression) {
+        return chunk_rows;
+    }
+
+    const auto width = std::max<size_t>(std::min(chunk_columns, n_columns), 1);
+
+    return std::max<size_t>((1 << 20) / (width * sizeof(float)), 1);
+}
+
+static hid_t create_type(const std::string &quantization)
+{
+    if (quantization == "none") {
+        return H5Tcopy(H5T_IEEE_F32LE);
+    } else if (quantization == "int8") {
+        return H5Tcopy(H5T_STD_I8LE);
+    } else if (quantization == "fp16") {
+        // Same layout as numpy.float16
+        const auto type = H5Tcopy(H5T_IEEE_F32LE);
+        H5Tset_fields(type, 15, 10, 5, 0, 10);
+        H5Tset_size(type, 2);
+        H5Tset_ebias(type, 15);
+
+        return type;
+    }
+
+    throw std::invalid_argument("Unknown quantization " + quantization);
+}
+
+template <class T>
+static void write_attribute(hid_t dataset, const char *name, hid_t type,
+                            T value)
+{
+    const auto space = H5Screate(H5S_SCALAR);
+    const auto attr =
+        H5Acreate2(dataset, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+
+    H5Awrite(attr, type, &value);
+
+    H5Aclose(attr);
+    H5Sclose(space);
+}
+
+HighFive::DataSet create_float_dataset(HighFive::File &file,
+                                       const std::string &name, size_t n_rows,
+                                       size_t n_columns,
+                                       const OutputLayout &layout)
+{
+    if (layout.compression > 9) {
+        throw std::invalid_argument("Compression level must be 0-9");
+    }
+
+    const auto type = create_type(layout.quantization);
+    const auto chunk_rows = layout.effective_chunk_rows(n_columns);
+    const hsize_t dims[2] = {n_rows, n_columns};
+    // Chunked datasets can be extended later
+    const hsize_t max_dims[2] = {H5S_UNLIMITED, H5S_UNLIMITED};
+    const auto space =
+        H5Screate_simple(2, dims, chunk_rows ? max_dims : nullptr);
+    const auto dcpl = H5Pcreate(H5P_DATASET_CREATE);
+
+    if (chunk_rows) {
+        // Chunk dimensions must be positive
+        const hsize_t chunk[2] = {
+            std::max<hsize_t>(std::min<hsize_t>(chunk_rows, n_rows), 1),
+            std::max<hsize_t>(
+                std::min<hsize_t>(layout.chunk_columns, n_columns), 1)};
+
+        H5Pset_chunk(dcpl, 2, chunk);
+    }
+
+    if (layout.compression) {
+        H5Pset_shuffle(dcpl);
+        H5Pset_deflate(dcpl, layout.compression);
+    }
+
+    const auto dataset = H5Dcreate2(file.getId(), name.c_str(), type, space,
+                                    H5P_DEFAULT, dcpl, H5P_DEFAULT);
+
+    H5Pclose(dcpl);
+    H5Sclose(space);
+    H5Tclose(type);
+
+    if (dataset < 0) {
+        throw std::runtime_error("Failed to create dataset " + name);
+    }
+
+    if (layout.quantization == "int8") {
+        write_attribute(dataset, "scale_factor", H5T_NATIVE_FLOAT,
+                        1.0f / 127.0f);
+        write_attribute(dataset, "missing_value", H5T_NATIVE_SCHAR,
+                        static_cast<signed char>(-128));
+    }
+
+    H5Dclose(dataset);
+
+    return file.getDataSet(name);
+}
+
+// H5Aiterate2 callback copying attribute `name` to the dataset pointed to by
+// `data`. Returns a negative value on failure, which stops the iteration.
+static herr_t copy_attribute(hid_t location, const char *name,
+                             const H5A_info_t *, void *data)
+{
+    const auto dst = *static_cast<hid_t *>(data);
+    const auto attr = H5Aopen(location, name, H5P_DEFAULT);
+
+    if (attr < 0) {
+        return -1;
+    }
+
+    const auto type = H5Aget_type(attr);
+    const auto space = H5Aget_space(attr);
+    std::vector<char> value(H5Aget_storage_size(attr));
+
+    auto status = H5Aread(attr, type, value.data());
+
+    if (status >= 0) {
+        const auto copy =
+            H5Acreate2(dst, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+
+        status = copy < 0 ? -1 : H5Awrite(copy, type, value.data());
+
+        if (copy >= 0) {
+            H5Aclose(copy);
+        }
+    }
+
+    H5Sclose(space);
+    H5Tclose(type);
+    H5Aclose(attr);
+
+    return status < 0 ? -1 : 0;
+}
+
+// Copy the values of the two-dimensional dataset `src` into the top left
+// corner of `dst` in blocks of rows
+static void copy_values(hid_t src, hid_t dst, const hsize_t dims[2])
+{
+    const auto type = H5Dget_type(src);
+    const auto row_bytes =
+        std::max<size_t>(dims[1] * H5Tget_size(type), 1);
+    const auto block_rows = std::max<size_t>((16 << 20) / row_bytes, 1);
+    std::vector<char> buffer(std::min<size_t>(block_rows, dims[0]) *
+                             row_bytes);
+
+    const auto src_space = H5Dget_space(src);
+    const auto dst_space = H5Dget_space(dst);
+
+    for (hsize_t row = 0; row < dims[0]; row += block_rows) {
+        const hsize_t start[2] = {row, 0};
+        const hsize_t count[2] = {
+            std::min<hsize_t>(block_rows, dims[0] - row), dims[1]};
+        const auto mem_space = H5Screate_simple(2, count, nullptr);
+
+        H5Sselect_hyperslab(src_space, H5S_SELECT_SET, start, nullptr, count,
+                            nullptr);
+        H5Sselect_hyperslab(dst_space, H5S_SELECT_SET, start, nullptr, count,
+                            nullptr);
+
+        // Values are copied as stored, so quantized values are unchanged
+        const auto failed =
+            H5Dread(src, type, mem_space, src_space, H5P_DEFAULT,
+                    buffer.data()) < 0 ||
+            H5Dwrite(dst, type, mem_space, dst_space, H5P_DEFAULT,
+                     buffer.data()) < 0;
+
+        H5Sclose(mem_space);
+
+        if (failed) {
+            H5Sclose(dst_space);
+            H5Sclose(src_space);
+            H5Tclose(type);
+            throw std::runtime_error("Failed to copy dataset");
+        }
+    }
+
+    H5Sclose(dst_space);
+    H5Sclose(src_space);
+    H5Tclose(type);
+}
+
+HighFive::DataSet resize_float_dataset(HighFive::File &file,
+                                       const std::string &name, size_t n_rows,
+                                       size_t n_columns)
+{
+    auto dataset = file.getDataSet(name);
+
+    const auto space = H5Dget_space(dataset.getId());
+    hsize_t dims[2], max_dims[2];
+    const auto rank = H5Sget_simple_extent_ndims(space);
+
+    if (rank == 2) {
+        H5Sget_simple_extent_dims(space, dims, max_dims);
+    }
+    H5Sclose(space);
+
+    if (rank != 2 || n_rows < dims[0] || n_columns < dims[1]) {
+        throw std::invalid_argument("Cannot resize dataset " + name);
+    }
+
+    const hsize_t new_dims[2] = {n_rows, n_columns};
+
+    if (max_dims[0] >= n_rows && max_dims[1] >= n_columns) {
+        if (H5Dset_extent(dataset.getId(), new_dims) < 0) {
+            throw std::runtime_error("Failed to resize dataset " + name);
+        }
+
+        return file.getDataSet(name);
+    }
+
+    const auto old_name = name + ".old";
+
+    if (H5Lmove(file.getId(), name.c_str(), file.getId(), old_name.c_str(),
+                H5P_DEFAULT, H5P_DEFAULT) < 0) {
+        throw std::runtime_error("Failed to resize dataset " + name);
+    }
+
+    const auto type = H5Dget_type(dataset.getId());
+    const auto dcpl = H5Dget_create_plist(dataset.getId());
+    const auto new_space = H5Screate_simple(2, new_dims, nullptr);
+
+    auto resized = H5Dcreate2(file.getId(), name.c_str(), type, new_space,
+                              H5P_DEFAULT, dcpl, H5P_DEFAULT);
+
+    H5Sclose(new_space);
+    H5Pclose(dcpl);
+    H5Tclose(type);
+
+    if (resized < 0) {
+        throw std::runtime_error("Failed to create dataset " + name);
+    }
+
+    try {
+        if (H5Aiterate2(dataset.getId(), H5_INDEX_NAME, H5_ITER_NATIVE,
+                        nullptr, copy_attribute, &resized) < 0) {
+            throw std::runtime_error("Failed to copy attributes of " + name);
+        }
+        copy_values(dataset.getId(), resized, dims);
+    } catch (...) {
+        H5Dclose(resized);
+        throw;
+    }
+
+    H5Dclose(resized);
+    H5Ldelete(file.getId(), old_name.c_str(), H5P_DEFAULT);
+
+    return file.getDataSet(name);
+}
@@ -0,0 +1,55 @@
+#ifndef __OUTPUT_LAYOUT_H__
+#define __OUTPUT_LAYOUT_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <highfive/H5DataSet.hpp>
+#include <highfive/H5File.hpp>
+
+// Storage layout of a two-dimensional float output dataset
+struct OutputLayout {
+    OutputLayout()
+        : chunk_rows(0), chunk_columns(4096), compression(0),
+          quantization("none")
+    {
+    }
+
+    // Rows per chunk. Zero stores the dataset contiguously unless
+    // compression is enabled, in which case chunks of about 1 MiB are used.
+    size_t chunk_rows;
+    // Columns per chunk. Limiting the chunk width keeps reads of sub-blocks
+    // from decompressing whole rows.
+    size_t chunk_columns;
+    // Deflate level (0-9) applied after byte shuffling, zero disables
+    uint32_t compression;
+    // Storage type of the values:
+    //   none: 32-bit float
+    //   fp16: 16-bit IEEE half precision float
+    //   int8: 8-bit fixed point in [-1, 1]. Values are stored as
+    //         round(x / scale_factor), NaN as missing_value. Both are stored
+    //         as attributes of the dataset.
+    std::string quantization;
+
+    // Rows per chunk of a dataset with `n_columns` columns (0 if contiguous)
+    size_t effective_chunk_rows(size_t n_columns) const;
+};
+
+// Create a dataset of `n_rows` x `n_columns` floats stored with `layout`.
+// Throws std::invalid_argument if the layout is invalid.
+HighFive::DataSet create_float_dataset(HighFive::File &file,
+                                       const std::string &name, size_t n_rows,
+                                       size_t n_columns,
+                                       const OutputLayout &layout);
+
+// Grow the dataset `name` to `n_rows` x `n_columns`, keeping its values.
+// Chunked datasets created by create_float_dataset() are extended in place.
+// Other datasets are copied into a new dataset with the same type, layout
+// and attributes, and the space of the old one is only reclaimed by
+// h5repack. Throws std::invalid_argument if the dataset would shrink.
+HighFive::DataSet resize_float_dataset(HighFive::File &file,
+                                       const std::string &name, size_t n_rows,
+                                       size_t n_columns);
+
+#endif
@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <H5Apublic.h>
+#include <H5Dpublic.h>
+#include <H5Tpublic.h>
+
+#include "row_writer.h"
+
+HDF5RowWriter::HDF5RowWriter(const HighFive::DataSet &dataset)
+    : HDF5RowWriter(dataset, 0, dataset.getDimensions()[1])
+{
+}
+
+HDF5RowWriter::HDF5RowWriter(const HighFive::DataSet &dataset,
+                             size_t first_column, size_t n_columns)
+    : RowWriter(n_columns), dataset(dataset), first_column(first_column),
+      scale_factor(0.0f)
+{
+    const auto type = H5Dget_type(dataset.getId());
+
+    if (H5Tget_class(type) == H5T_INTEGER && H5Tget_size(type) == 1 &&
+        H5Aexists(dataset.getId(), "scale_factor") > 0) {
+        const auto attr = H5Aopen(dataset.getId(), "scale_factor", H5P_DEFAULT);
+        H5Aread(attr, H5T_NATIVE_FLOAT, &scale_factor);
+        H5Aclose(attr);
+    }
+
+    H5Tclose(type);
+}
+
+void HDF5RowWriter::write_rows(size_t start, size_t n_rows, const float *rows)
+{
+    if (!scale_factor) {
+        dataset.select({start, first_column}, {n_rows, _n_columns})
+            .write_raw(rows);
+        return;
+    }
+
+    quantized.resize(n_rows * _n_columns);
+
+    for (auto i = 0u; i < quantized.size(); i++) {
+        // NaN is stored as missing_value
+        if (std::isnan(rows[i])) {
+            quantized[i] = -128;
+        } else {
+            const auto q = std::round(rows[i] / scale_factor);
+
+            quantized[i] =
+                static_cast<int8_t>(std::min(std::max(q, -127.0f), 127.0f));
+        }
+    }
+
+    dataset.select({start, first_column}, {n_rows, _n_columns})
+        .write_raw(quantized.data());
+}
+
+MmapRowWriter::MmapRowWriter(const std::string &path, size_t n_rows,
+                             size_t n_columns)
+    : RowWriter(n_columns), data(nullptr),
+      size(n_rows * n_columns * sizeof(float))
+{
+    const auto fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        throw std::invalid_argument("Failed to open file " + path);
+    }
+
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        throw std::runtime_error("Failed to allocate file " + path);
+    }
+
+    // mmap does not accept empty mappings
+    if (size > 0) {
+        const auto addr =
+            mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Failed to map file " + path);
+        }
+
+        data = static_cast<float *>(addr);
+    }
+
+    close(fd);
+}
+
+MmapRowWriter::~MmapRowWriter()
+{
+    if (data) {
+        munmap(data, size);
+    }
+}
+
+void MmapRowWriter::write_rows(size_t start, size_t n_rows, const float *rows)
+{
+    // Rows computed in place through row() need no copy
+    if (rows != row(start)) {
+        std::copy(rows, rows + n_rows * _n_columns, row(start));
+    }
+}
+
+void MmapRowWriter::flush()
+{
+    if (data && msync(data, size, MS_SYNC) < 0) {
+        throw std::runtime_error("Failed to write back mapped file");
+    }
+}
+
+AsyncRowWriter::AsyncRowWriter(RowWriter &sink, size_t block_rows,
+                               size_t queue_depth)
+    : RowWriter(sink.n_columns()), sink(sink),
+      block_rows(std::max<size_t>(block_rows, 1)),
+      queue_depth(std::max<size_t>(queue_depth, 1)), busy(false),
+      done(false), worker(&AsyncRowWriter::run, this)
+{
+}
+
+AsyncRowWriter::~AsyncRowWriter()
+{
+    try {
+        flush();
+    } catch (...) {
+        // Destructors must not throw; call flush() to observe errors
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    cond.notify_all();
+
+    worker.join();
+}
+
+void AsyncRowWriter::write_rows(size_t start, size_t n_rows, const float *rows)
+{
+    rethrow_error();
+
+    for (auto i = 0u; i < n_rows; i++) {
+        const auto row = start + i;
+
+        // Start a new block unless the row continues the current one
+        if (current && (current->start + current->n_rows != row ||
+                        current->n_rows == block_rows)) {
+            enqueue_current();
+        }
+
+        if (!current) {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            if (!free_blocks.empty()) {
+                current = std::move(free_blocks.back());
+                free_blocks.pop_back();
+            } else {
+                current.reset(new Block());
+                current->data.resize(block_rows * _n_columns);
+            }
+
+            current->start = row;
+            current->n_rows = 0;
+        }
+
+        std::copy(rows + i * _n_columns, rows + (i + 1) * _n_columns,
+                  current->data.begin() + current->n_rows * _n_columns);
+        current->n_rows++;
+    }
+
+    if (current && current->n_rows == block_rows) {
+        enqueue_current();
+    }
+}
+
+void AsyncRowWriter::submit()
+{
+    rethrow_error();
+
+    if (current) {
+        enqueue_current();
+    }
+}
+
+void AsyncRowWriter::flush()
+{
+    if (current) {
+        enqueue_current();
+    }
+
+    timer_wait.start();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return queue.empty() && !busy; });
+    }
+    timer_wait.stop();
+
+    rethrow_error();
+
+    sink.flush();
+}
+
+void AsyncRowWriter::enqueue_current()
+{
+    timer_wait.start();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return queue.size() < queue_depth; });
+
+        queue.push_back(std::move(current));
+    }
+    timer_wait.stop();
+
+    cond.notify_all();
+}
+
+void AsyncRowWriter::rethrow_error()
+{
+    std::exception_ptr e;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(e, error);
+    }
+
+    if (e) {
+        std::rethrow_exception(e);
+    }
+}
+
+void AsyncRowWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        cond.wait(lock, [this] { return !queue.empty() || done; });
+
+        if (queue.empty()) {
+            return;
+        }
+
+        auto block = std::move(queue.front());
+        queue.pop_front();
+        busy = true;
+        lock.unlock();
+        cond.notify_all();
+
+        timer_io.start();
+        try {
+            sink.write_rows(block->start, block->n_rows, block->data.data());
+        } catch (...) {
+            lock.lock();
+            error = std::current_exception();
+            lock.unlock();
+        }
+        timer_io.stop();
+
+        lock.lock();
+        free_blocks.push_back(std::move(block));
+        busy = false;
+        cond.notify_all();
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef __ROW_WRITER_H__
+#define __ROW_WRITER_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <highfive/H5DataSet.hpp>
+
+#include "timer.h"
+
+// Sink for rows of a two-dimensional float dataset
+class RowWriter
+{
+public:
+    explicit RowWriter(size_t n_columns) : _n_columns(n_columns) {}
+    virtual ~RowWriter() {}
+
+    // Write `n_rows` consecutive rows starting at row `start`. `rows` holds
+    // n_rows * n_columns() values in row-major order.
+    virtual void write_rows(size_t start, size_t n_rows, const float *rows) = 0;
+    // Make sure all rows written so far have reached the sink
+    virtual void flush() {}
+
+    size_t n_columns() const { return _n_columns; }
+
+protected:
+    size_t _n_columns;
+};
+
+// Writes rows to an HDF5 dataset. Values are converted to the storage type
+// of the dataset, including the quantized types of OutputLayout.
+class HDF5RowWriter : public RowWriter
+{
+public:
+    explicit HDF5RowWriter(const HighFive::DataSet &dataset);
+    // Only write columns [first_column, first_column + n_columns) of the
+    // dataset
+    HDF5RowWriter(const HighFive::DataSet &dataset, size_t first_column,
+                  size_t n_columns);
+
+    void write_rows(size_t start, size_t n_rows, const float *rows) override;
+
+protected:
+    HighFive::DataSet dataset;
+    size_t first_column;
+    // Fixed point scale of int8 datasets, zero if stored as floats
+    float scale_factor;
+    std::vector<int8_t> quantized;
+};
+
+// Writes rows into a flat file of n_rows x n_columns row-major floats that
+// is mapped into memory, e.g. for numpy.memmap. Callers can also compute
+// rows in place through row().
+class MmapRowWriter : public RowWriter
+{
+public:
+    MmapRowWriter(const std::string &path, size_t n_rows, size_t n_columns);
+    ~MmapRowWriter();
+
+    MmapRowWriter(const MmapRowWriter &) = delete;
+    MmapRowWriter &operator=(const MmapRowWriter &) = delete;
+
+    // Row `i` inside the mapping
+    float *row(size_t i) { return data + i * _n_columns; }
+
+    void write_rows(size_t start, size_t n_rows, const float *rows) override;
+    // Write dirty pages back to the file
+    void flush() override;
+
+protected:
+    float *data;
+    size_t size;
+};
+
+// Aggregates consecutive rows into blocks of `block_rows` rows and writes
+// them to `sink` from a background thread, so that I/O overlaps with
+// computation. At most `queue_depth` blocks are queued; writers block when
+// the queue is full. Errors raised by the sink are rethrown from the next
+// call to write_rows() or flush().
+class AsyncRowWriter : public RowWriter
+{
+public:
+    AsyncRowWriter(RowWriter &sink, size_t block_rows, size_t queue_depth = 2);
+    ~AsyncRowWriter();
+
+    AsyncRowWriter(const AsyncRowWriter &) = delete;
+    AsyncRowWriter &operator=(const AsyncRowWriter &) = delete;
+
+    void write_rows(size_t start, size_t n_rows, const float *rows) override;
+    // Queue the partially filled block without waiting for it to be written
+    void submit();
+    // Write the partially filled block and wait until the queue is drained
+    void flush() override;
+
+    // Time the background thread spent writing to the sink
+    double io_time() const { return timer_io.elapsed(); }
+    // Time the calling thread spent waiting for the queue
+    double wait_time() const { return timer_wait.elapsed(); }
+
+protected:
+    struct Block {
+        size_t start;
+        size_t n_rows;
+        std::vector<float> data;
+    };
+
+    RowWriter &sink;
+    size_t block_rows;
+    size_t queue_depth;
+
+    // Block being filled by the caller
+    std::unique_ptr<Block> current;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::unique_ptr<Block>> queue;
+    std::vector<std::unique_ptr<Block>> free_blocks;
+    bool busy;
+    bool done;
+    std::exception_ptr error;
+
+    Timer timer_io;
+    Timer timer_wait;
+
+    // Started last so that all other members are initialized
+    std::thread worker;
+
+    void enqueue_current();
+    void rethrow_error();
+    void run();
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "data_frame.h"
 #include "lut.h"
+#include "uninitialized_vector.h"
 
 class Simplex
 {
@@ -16,7 +17,7 @@ public:
     // Predict timeseries using Simplex projection. `prediction` is the
     // predicted rsult. The actual values are stored into `buffer`. `lut`
     // needs to be pre-computed using NearestNeighbors and normalized.
-    virtual Series predict(std::vector<float> &buffer, const LUT &lut,
+    virtual Series predict(scratch_vector<float> &buffer, const LUT &lut,
                            const Series &target, uint32_t E) = 0;
 
     // Shift and trim the target timeseries so that its time index matches the
@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 
 #include <argh.h>
 
@@ -26,6 +27,15 @@ void usage(const std::string &app_name)
         "  -e, --maxe arg   Maximum embedding dimension (default: 20)\n"
         "  -p, --Tp arg     Steps to predict in future (default: 1)\n"
         "  -x, --kernel arg Kernel type {cpu|gpu|multigpu} (default: cpu)\n"
+        "  -s, --search arg E search {exhaustive|patience|coarse} (default: "
+        "exhaustive)\n"
+        "  -P, --patience arg\n"
+        "                   Steps without improvement before the patience "
+        "search\n"
+        "                   stops (default: 3)\n"
+        "  -S, --stride arg Grid spacing of the coarse search (default: 4)\n"
+        "  -f, --folds arg  Select E by cross validation over {K|loo} folds\n"
+        "  -b, --batch      Evaluate all timeseries in one batch\n"
         "  -v, --verbose    Enable verbose logging (default: false)\n"
         "  -h, --help       Show help";
 
@@ -35,7 +45,8 @@ void usage(const std::string &app_name)
 int main(int argc, char *argv[])
 {
     argh::parser cmdl({"-t", "--tau", "-p", "--tp", "-e", "--maxe", "-x",
-                       "--kernel", "-v", "--verbose"});
+                       "--kernel", "-s", "--search", "-P", "--patience", "-S",
+                       "--stride", "-f", "--folds", "-v", "--verbose"});
     cmdl.parse(argc, argv);
 
     if (cmdl[{"-h", "--help"}]) {
@@ -58,6 +69,37 @@ int main(int argc, char *argv[])
     cmdl({"e", "maxe"}, 20) >> max_E;
     std::string kernel_type;
     cmdl({"x", "kernel"}, "cpu") >> kernel_type;
+    std::string search;
+    cmdl({"s", "search"}, "exhaustive") >> search;
+    uint32_t patience;
+    cmdl({"P", "patience"}, 3) >> patience;
+    uint32_t stride;
+    cmdl({"S", "stride"}, 4) >> stride;
+    std::string folds;
+    cmdl({"f", "folds"}, "0") >> folds;
+    uint32_t n_folds = EmbeddingDim::leave_one_out;
+    if (folds != "loo") {
+        auto valid = false;
+
+        try {
+            size_t end;
+            const auto n = std::stoul(folds, &end);
+
+            // stoul accepts negative numbers. A single fold leaves no
+            // library to predict from.
+            valid = end == folds.size() && folds[0] != '-' && n != 1 &&
+                    n < EmbeddingDim::leave_one_out;
+            n_folds = n;
+        } catch (const std::logic_error &) {
+        }
+
+        if (!valid) {
+            std::cerr << "Invalid number of folds " << folds << std::endl;
+            usage(cmdl[0]);
+            return 1;
+        }
+    }
+    bool batch = cmdl[{"b", "batch"}];
     bool verbose = cmdl[{"v", "verbose"}];
 
     Timer timer_tot;
@@ -97,13 +139,28 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    for (auto i = 0u; i < df.columns.size(); i++) {
-        std::cout << "Simplex projection for timeseries #" << i << ": ";
+    embedding_dim->set_search_policy(search, patience, stride);
+    embedding_dim->set_folds(n_folds);
+
+    if (batch) {
+        std::cout << "Simplex projection for " << df.columns.size()
+                  << " timeseries" << std::endl;
 
-        const auto best_E = embedding_dim->run(df.columns[i]);
+        const auto optimal_E = embedding_dim->run_batch(df.columns);
 
-        if (verbose) {
-            std::cout << "best E=" << best_E << std::endl;
+        for (auto i = 0u; verbose && i < optimal_E.size(); i++) {
+            std::cout << "Timeseries #" << i << ": best E=" << optimal_E[i]
+                      << std::endl;
+        }
+    } else {
+        for (auto i = 0u; i < df.columns.size(); i++) {
+            std::cout << "Simplex projection for timeseries #" << i << ": ";
+
+            const auto best_E = embedding_dim->run(df.columns[i]);
+
+            if (verbose) {
+                std::cout << "best E=" << best_E << std::endl;
+            }
         }
     }
 
@@ -112,5 +169,12 @@ int main(int argc, char *argv[])
     std::cout << "Processed dataset in " << timer_tot.elapsed() << " [ms]"
               << std::endl;
 
+    const auto n_evaluated = embedding_dim->n_evaluated();
+    const auto n_exhaustive = embedding_dim->n_exhaustive();
+
+    std::cout << "Evaluated " << n_evaluated << " of " << n_exhaustive
+              << " embedding dimensions (saved "
+              << n_exhaustive - n_evaluated << ")" << std::endl;
+
     return 0;
 }
@@ -1,6 +1,6 @@
 #include "simplex_cpu.h"
 
-Series SimplexCPU::predict(std::vector<float> &buffer, const LUT &lut,
+Series SimplexCPU::predict(scratch_vector<float> &buffer, const LUT &lut,
                            const Series &target, uint32_t E)
 {
     buffer.resize(lut.n_rows());
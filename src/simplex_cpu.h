@@ -14,7 +14,7 @@ public:
     }
     ~SimplexCPU(){};
 
-    Series predict(std::vector<float> &buffer, const LUT &lut,
+    Series predict(scratch_vector<float> &buffer, const LUT &lut,
                    const Series &target, uint32_t E) override;
 
 protected:
@@ -2,7 +2,7 @@
 
 #include "simplex_gpu.h"
 
-Series SimplexGPU::predict(std::vector<float> &buffer, const LUT &lut,
+Series SimplexGPU::predict(scratch_vector<float> &buffer, const LUT &lut,
                            const Series &target, uint32_t E)
 {
     buffer.resize(lut.n_rows());
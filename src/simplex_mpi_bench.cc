@@ -23,18 +23,20 @@ protected:
     DataFrame df;
     uint32_t current_id;
 
-    void next_task(nlohmann::json &task) override
+    void next_task(MPITask &task) override
     {
-        task["id"] = current_id;
+        task.start = current_id;
+        task.stop = current_id + 1;
         current_id++;
     }
 
     bool task_left() const override { return current_id < df.columns.size(); }
 
-    void task_done(const nlohmann::json &result) override
+    void task_done(const MPIResult &result) override
     {
-        std::cout << "Timeseries #" << result["id"] << " best E=" << result["E"]
-                  << " rho=" << result["rho"] << std::endl;
+        std::cout << "Timeseries #" << result.start
+                  << " best E=" << result.E[0] << " rho=" << result.rho[0]
+                  << std::endl;
     }
 };
 
@@ -54,9 +56,9 @@ protected:
     std::unique_ptr<NearestNeighbors> knn;
     std::unique_ptr<Simplex> simplex;
 
-    void do_task(nlohmann::json &result, const nlohmann::json &task) override
+    void do_task(MPIResult &result, const MPITask &task) override
     {
-        const auto id = task["id"];
+        const auto id = task.start;
 
         const auto ts = df.columns[id];
 
@@ -65,7 +67,7 @@ protected:
         const auto target = ts.slice(ts.size() / 2);
 
         std::vector<float> rhos(20);
-        std::vector<float> buffer;
+        scratch_vector<float> buffer;
 
         LUT lut;
 
@@ -83,9 +85,10 @@ protected:
         const auto max_E = it - rhos.begin() + 1;
         const auto maxRho = *it;
 
-        result["id"] = id;
-        result["E"] = max_E;
-        result["rho"] = maxRho;
+        result.start = task.start;
+        result.stop = task.stop;
+        result.E = {static_cast<uint32_t>(max_E)};
+        result.rho = {maxRho};
     }
 };
 
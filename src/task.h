@@ -0,0 +1,53 @@
+#ifndef __TASK_H__
+#define __TASK_H__
+
+#include <cstdint>
+#include <vector>
+
+// Range of ids [start, stop) to process, e.g. time series or libraries
+struct Task {
+    uint64_t start;
+    uint64_t stop;
+};
+
+// Outcome of a Task. `E` and `rho` hold one value per id in [start, stop)
+// and are only set by tasks that evaluate embedding dimensions. `elapsed`
+// is the time spent on the task in [ms].
+struct TaskResult {
+    uint64_t start;
+    uint64_t stop;
+    float elapsed;
+    std::vector<uint32_t> E;
+    std::vector<float> rho;
+};
+
+// Generates tasks and consumes their results. The same master can be run by
+// any of the schedulers, within a process or across MPI ranks.
+class TaskMaster
+{
+public:
+    virtual ~TaskMaster() {}
+
+protected:
+    friend class MPIRMAScheduler;
+    friend class ThreadScheduler;
+
+    virtual void next_task(Task &task) = 0;
+    virtual bool task_left() const = 0;
+    virtual void task_done(const TaskResult &result){};
+};
+
+// Processes tasks generated by a TaskMaster
+class TaskWorker
+{
+public:
+    virtual ~TaskWorker() {}
+
+protected:
+    friend class MPIRMAScheduler;
+    friend class ThreadScheduler;
+
+    virtual void do_task(TaskResult &result, const Task &task) = 0;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include <algorithm>
+
+#include "task_planner.h"
+
+std::vector<TaskRange> plan_fixed_tasks(const std::vector<double> &costs,
+                                        const std::vector<uint8_t> &completed,
+                                        size_t chunk_size)
+{
+    std::vector<TaskRange> tasks;
+    chunk_size = std::max<size_t>(chunk_size, 1);
+
+    for (size_t id = 0; id < costs.size();) {
+        if (completed[id]) {
+            id++;
+            continue;
+        }
+
+        TaskRange task = {id, id, 0.0};
+
+        while (task.stop < costs.size() && task.stop - id < chunk_size &&
+               !completed[task.stop]) {
+            task.cost += costs[task.stop];
+            task.stop++;
+        }
+
+        tasks.push_back(task);
+        id = task.stop;
+    }
+
+    return tasks;
+}
+
+std::vector<TaskRange> plan_guided_tasks(const std::vector<double> &costs,
+                                         const std::vector<uint8_t> &completed,
+                                         size_t n_workers, size_t min_chunk)
+{
+    std::vector<TaskRange> tasks;
+    min_chunk = std::max<size_t>(min_chunk, 1);
+    n_workers = std::max<size_t>(n_workers, 1);
+
+    auto remaining = 0.0;
+    for (size_t id = 0; id < costs.size(); id++) {
+        remaining += completed[id] ? 0.0 : costs[id];
+    }
+
+    for (size_t id = 0; id < costs.size();) {
+        if (completed[id]) {
+            id++;
+            continue;
+        }
+
+        const auto target = remaining / (2 * n_workers);
+        TaskRange task = {id, id, 0.0};
+
+        // Tasks are runs of ids left to do
+        while (task.stop < costs.size() && !completed[task.stop] &&
+               (task.stop - id < min_chunk || task.cost < target)) {
+            task.cost += costs[task.stop];
+            task.stop++;
+        }
+
+        remaining -= task.cost;
+        tasks.push_back(task);
+        id = task.stop;
+    }
+
+    std::stable_sort(tasks.begin(), tasks.end(),
+                     [](const TaskRange &a, const TaskRange &b) {
+                         return a.cost > b.cost;
+                     });
+
+    return tasks;
+}
@@ -0,0 +1,31 @@
+#ifndef __TASK_PLANNER_H__
+#define __TASK_PLANNER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Consecutive ids [start, stop) processed as one task, e.g. libraries
+struct TaskRange {
+    size_t start;
+    size_t stop;
+    // Sum of the costs of its ids
+    double cost;
+};
+
+// Split the ids that are not flagged in `completed` into tasks of up to
+// `chunk_size` consecutive ids, in index order. `costs` holds the cost of
+// every id, e.g. 1 to count ids.
+std::vector<TaskRange> plan_fixed_tasks(const std::vector<double> &costs,
+                                        const std::vector<uint8_t> &completed,
+                                        size_t chunk_size);
+
+// Guided self-scheduling over the ids not flagged in `completed`: every
+// task holds about 1 / (2 * n_workers) of the cost left when it is formed,
+// but at least `min_chunk` ids. Tasks are ordered by decreasing cost, so
+// expensive tasks start first and tasks shrink as work runs out.
+std::vector<TaskRange> plan_guided_tasks(const std::vector<double> &costs,
+                                         const std::vector<uint8_t> &completed,
+                                         size_t n_workers, size_t min_chunk);
+
+#endif
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <atomic>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "affinity.h"
+#include "thread_scheduler.h"
+#include "timer.h"
+
+void ThreadScheduler::run(TaskMaster &master,
+                          const std::vector<TaskWorker *> &workers)
+{
+    std::vector<Task> tasks;
+
+    while (master.task_left()) {
+        Task task;
+        master.next_task(task);
+        tasks.push_back(task);
+    }
+
+    std::atomic<size_t> next_id(0);
+    std::mutex result_mutex;
+    std::exception_ptr error;
+
+    n_worker_tasks.assign(workers.size(), 0);
+
+    const auto work_on = [&](size_t worker_id) {
+        try {
+            for (auto id = next_id++; id < tasks.size(); id = next_id++) {
+                TaskResult result = TaskResult();
+                Timer timer;
+
+                timer.start();
+                workers[worker_id]->do_task(result, tasks[id]);
+                result.elapsed = timer.stop();
+
+                std::lock_guard<std::mutex> lock(result_mutex);
+                master.task_done(result);
+                n_worker_tasks[worker_id]++;
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(result_mutex);
+
+            if (!error) {
+                error = std::current_exception();
+            }
+
+            // Let the other threads stop after their current task
+            next_id = tasks.size();
+        }
+    };
+
+    if (workers.size() == 1) {
+        work_on(0);
+    } else if (workers.size() > 1) {
+        if (threads.size() != workers.size()) {
+            stop_threads();
+            start_threads(workers.size());
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (start_error) {
+            std::rethrow_exception(start_error);
+        }
+
+        work = work_on;
+        n_running = threads.size();
+        generation++;
+        start_cond.notify_all();
+
+        done_cond.wait(lock, [this] { return n_running == 0; });
+        work = nullptr;
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadScheduler::start_threads(size_t n_threads)
+{
+#ifdef _OPENMP
+    const auto n_omp_threads =
+        std::max<int>(omp_get_max_threads() / n_threads, 1);
+#else
+    const auto n_omp_threads = 1;
+#endif
+
+    stopping = false;
+    start_error = nullptr;
+
+    for (size_t i = 0; i < n_threads; i++) {
+        threads.push_back(std::thread(&ThreadScheduler::thread_main, this, i,
+                                      n_threads, n_omp_threads, generation));
+    }
+}
+
+void ThreadScheduler::stop_threads()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_cond.notify_all();
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+void ThreadScheduler::thread_main(size_t worker_id, size_t n_threads,
+                                  int n_omp_threads, uint64_t seen)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(n_omp_threads);
+#else
+    (void)n_omp_threads;
+#endif
+
+    // New threads inherit the affinity of the caller, which may be pinned
+    // to a single CPU
+    try {
+        pin_threads(affinity, worker_id, n_threads);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!start_error) {
+            start_error = std::current_exception();
+        }
+    }
+
+    while (true) {
+        std::function<void(size_t)> current;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_cond.wait(lock,
+                            [&] { return stopping || generation != seen; });
+
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            current = work;
+        }
+
+        current(worker_id);
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (--n_running == 0) {
+            done_cond.notify_one();
+        }
+    }
+}
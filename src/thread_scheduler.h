@@ -0,0 +1,77 @@
+#ifndef __THREAD_SCHEDULER_H__
+#define __THREAD_SCHEDULER_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "task.h"
+
+// Distributes the tasks of a TaskMaster over threads of this process,
+// without MPI. Tasks are enumerated up front and every thread claims the
+// next task id from an atomic counter, so claiming a task never blocks.
+// Each thread runs its own worker, so workers may own kernels and buffers
+// that are not thread-safe. task_done() is called under a lock by the
+// thread that ran the task.
+//
+// The threads, and the OpenMP threads they start, are kept alive between
+// calls to run() so that short runs do not pay for starting them again.
+class ThreadScheduler
+{
+public:
+    // Workers pin their OpenMP threads to their own share of the CPUs
+    // according to `affinity` (see pin_threads())
+    explicit ThreadScheduler(const std::string &affinity = "none")
+        : affinity(affinity), generation(0), n_running(0), stopping(false)
+    {
+    }
+    ~ThreadScheduler() { stop_threads(); }
+
+    ThreadScheduler(const ThreadScheduler &) = delete;
+    ThreadScheduler &operator=(const ThreadScheduler &) = delete;
+
+    // Run one thread per worker. The OpenMP threads of the caller are split
+    // evenly among them. A single worker runs in the calling thread. The
+    // first exception thrown by a worker is rethrown once all threads have
+    // stopped.
+    void run(TaskMaster &master, const std::vector<TaskWorker *> &workers);
+
+    // Number of tasks run by every worker in the last call to run()
+    const std::vector<uint64_t> &tasks_per_worker() const
+    {
+        return n_worker_tasks;
+    }
+
+protected:
+    std::string affinity;
+    std::vector<uint64_t> n_worker_tasks;
+
+    // One thread per worker of the last run() with more than one worker
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    // Signals a new run to the threads
+    std::condition_variable start_cond;
+    // Signals the caller that every thread finished the current run
+    std::condition_variable done_cond;
+    // Work of the current run, called with the id of the worker
+    std::function<void(size_t)> work;
+    // Number of runs handed to the threads
+    uint64_t generation;
+    size_t n_running;
+    bool stopping;
+    // Error while starting the threads, reported by the next run
+    std::exception_ptr start_error;
+
+    void start_threads(size_t n_threads);
+    void stop_threads();
+    // Serve the runs after run number `seen` with worker `worker_id`
+    void thread_main(size_t worker_id, size_t n_threads, int n_omp_threads,
+                     uint64_t seen);
+};
+
+#endif
@@ -1,9 +1,255 @@
 #ifndef __UNINITIALIZED_ALLOCATOR_H__
 #define __UNINITIALIZED_ALLOCATOR_H__
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
 #include <memory>
+#include <new>
+#include <ostream>
+#include <utility>
 #include <vector>
 
+#include <sys/mman.h>
+
+// Counters reported by ScratchArena::stats()
+struct ArenaStats {
+    // Number of blocks obtained from the system allocator
+    size_t allocations;
+    // Number of requests served from a previously released block
+    size_t reuses;
+    // Total bytes obtained from the system allocator
+    size_t bytes_allocated;
+    // Bytes currently held by live blocks and per-thread caches
+    size_t bytes_reserved;
+};
+
+// Pool of 64-byte aligned scratch buffers. Released blocks are kept in a
+// small per-thread cache and handed out again to later requests that fit, so
+// buffers that are resized on every call (distance matrices, lookup tables,
+// prediction buffers) settle at their high-water mark instead of going back
+// to the system allocator and page-faulting again. Blocks of 2 MB or more can
+// optionally be backed by transparent huge pages.
+class ScratchArena
+{
+public:
+    static const size_t alignment = 64;
+    static const size_t huge_page_size = 2 * 1024 * 1024;
+    // Maximum number of released blocks cached per thread
+    static const size_t max_cached_blocks = 4;
+
+    static void *allocate(size_t bytes)
+    {
+        if (cache_alive()) {
+            auto &blocks = cache().blocks;
+            auto best = blocks.end();
+
+            // Pick the smallest cached block that is large enough
+            for (auto it = blocks.begin(); it != blocks.end(); it++) {
+                if (capacity(*it) >= bytes &&
+                    (best == blocks.end() || capacity(*it) < capacity(*best))) {
+                    best = it;
+                }
+            }
+
+            if (best != blocks.end()) {
+                const auto block = *best;
+                blocks.erase(best);
+                counters().reuses++;
+                return block;
+            }
+        }
+
+        auto size = round_up(header_size + std::max<size_t>(bytes, 1),
+                             alignment);
+        auto align = alignment;
+
+        if (huge_pages() && size >= huge_page_size) {
+            size = round_up(size, huge_page_size);
+            align = huge_page_size;
+        }
+
+        void *raw = nullptr;
+        if (posix_memalign(&raw, align, size)) {
+            throw std::bad_alloc();
+        }
+
+#ifdef MADV_HUGEPAGE
+        if (align == huge_page_size) {
+            madvise(raw, size, MADV_HUGEPAGE);
+        }
+#endif
+
+        *static_cast<size_t *>(raw) = size;
+
+        counters().allocations++;
+        counters().bytes_allocated += size;
+        counters().bytes_reserved += size;
+
+        return static_cast<char *>(raw) + header_size;
+    }
+
+    static void deallocate(void *p)
+    {
+        if (!p) {
+            return;
+        }
+
+        if (cache_alive()) {
+            auto &blocks = cache().blocks;
+
+            blocks.push_back(p);
+
+            if (blocks.size() <= max_cached_blocks) {
+                return;
+            }
+
+            // Evict the smallest block to retain the high-water mark
+            const auto it = std::min_element(
+                blocks.begin(), blocks.end(), [](void *a, void *b) {
+                    return capacity(a) < capacity(b);
+                });
+            p = *it;
+            blocks.erase(it);
+        }
+
+        release(p);
+    }
+
+    // Use transparent huge pages for blocks of 2 MB or larger
+    static void set_huge_pages(bool enable) { huge_pages() = enable; }
+
+    static ArenaStats stats()
+    {
+        ArenaStats s;
+
+        s.allocations = counters().allocations;
+        s.reuses = counters().reuses;
+        s.bytes_allocated = counters().bytes_allocated;
+        s.bytes_reserved = counters().bytes_reserved;
+
+        return s;
+    }
+
+    static void print_stats(std::ostream &os)
+    {
+        const auto s = stats();
+
+        os << "Scratch arena: " << s.allocations << " allocations ("
+           << s.bytes_allocated / 1024 / 1024 << " [MiB]), " << s.reuses
+           << " reuses, " << s.bytes_reserved / 1024 / 1024
+           << " [MiB] reserved" << std::endl;
+    }
+
+protected:
+    // Size of the block header that stores the block size. Equal to the
+    // alignment so that the returned pointer stays aligned.
+    static const size_t header_size = alignment;
+
+    struct Counters {
+        std::atomic<size_t> allocations;
+        std::atomic<size_t> reuses;
+        std::atomic<size_t> bytes_allocated;
+        std::atomic<size_t> bytes_reserved;
+    };
+
+    struct Cache {
+        std::vector<void *> blocks;
+
+        ~Cache()
+        {
+            cache_alive() = false;
+
+            for (auto p : blocks) {
+                release(p);
+            }
+        }
+    };
+
+    static size_t round_up(size_t n, size_t align)
+    {
+        return (n + align - 1) / align * align;
+    }
+
+    static size_t capacity(void *p)
+    {
+        return *reinterpret_cast<size_t *>(static_cast<char *>(p) -
+                                           header_size) -
+               header_size;
+    }
+
+    static void release(void *p)
+    {
+        void *raw = static_cast<char *>(p) - header_size;
+
+        counters().bytes_reserved -= *static_cast<size_t *>(raw);
+        free(raw);
+    }
+
+    static Counters &counters()
+    {
+        static Counters c = {{0}, {0}, {0}, {0}};
+        return c;
+    }
+
+    static bool &huge_pages()
+    {
+        static bool enabled = false;
+        return enabled;
+    }
+
+    static Cache &cache()
+    {
+        static thread_local Cache c;
+        return c;
+    }
+
+    // Blocks released while a thread is exiting bypass the destroyed cache
+    static bool &cache_alive()
+    {
+        static thread_local bool alive = true;
+        return alive;
+    }
+};
+
+// Stateless allocator backed by ScratchArena
+template <typename T> struct arena_allocator {
+    typedef T value_type;
+
+    arena_allocator() noexcept {}
+    template <typename U> arena_allocator(const arena_allocator<U> &) noexcept
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(ScratchArena::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t) { ScratchArena::deallocate(p); }
+
+    template <typename U, typename... Args>
+    void construct(U *p, Args &&... args)
+    {
+        ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U> void destroy(U *p) { p->~U(); }
+};
+
+template <typename T, typename U>
+bool operator==(const arena_allocator<T> &, const arena_allocator<U> &)
+{
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const arena_allocator<T> &, const arena_allocator<U> &)
+{
+    return false;
+}
+
 // below code is taken from https://stackoverflow.com/questions/15952412
 
 // based on a design by Jared Hoberock
@@ -52,4 +298,10 @@ template <typename T, typename base_allocator = std::allocator<T>>
 using uninitialized_vector =
     std::vector<T, uninitialized_allocator<T, base_allocator>>;
 
+// Kernel scratch buffer (distance matrix, lookup table, prediction) served
+// from ScratchArena. Datasets use uninitialized_vector so that their memory
+// goes back to the system when freed.
+template <typename T>
+using scratch_vector = uninitialized_vector<T, arena_allocator<T>>;
+
 #endif
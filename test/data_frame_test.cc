@@ -0,0 +1,150 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/data_frame.h"
+
+TEST_CASE("Load CSV file", "[dataframe]")
+{
+    DataFrame df;
+    df.load_csv("data_frame_test_data.csv");
+
+    REQUIRE(df.n_rows() == 4);
+    REQUIRE(df.n_columns() == 3);
+
+    const char *cells[4][3] = {
+        {"1", "2", "3"},
+        {"0.5", "-1.25e2", "+7E-3"},
+        {"1.00000001192092896", "3.4028235e38", "1.5e-30"},
+        {"-0", "0.1", "123456789012345678901234"},
+    };
+
+    for (auto i = 0u; i < df.n_rows(); i++) {
+        for (auto j = 0u; j < df.n_columns(); j++) {
+            REQUIRE(df.columns[j][i] == std::stof(cells[i][j]));
+        }
+    }
+}
+
+TEST_CASE("Load CSV file with a malformed row", "[dataframe]")
+{
+    DataFrame df;
+
+    REQUIRE_THROWS_AS(df.load_csv("data_frame_test_malformed.csv"),
+                      std::invalid_argument);
+}
+
+TEST_CASE("Parsed floats are identical to strtof", "[dataframe]")
+{
+    const auto path = "data_frame_test_random.csv";
+    const auto n_rows = 10000u;
+
+    std::mt19937 engine(42);
+    std::uniform_int_distribution<uint32_t> bits;
+    std::uniform_int_distribution<int> precision(1, 17);
+    std::vector<std::string> cells;
+
+    std::ofstream ofs(path);
+    ofs << "x" << std::endl;
+
+    for (auto i = 0u; i < n_rows; i++) {
+        // Random float printed with a random number of digits
+        float f;
+        do {
+            const auto b = bits(engine);
+            std::memcpy(&f, &b, sizeof(f));
+        } while (!std::isfinite(f));
+
+        std::ostringstream oss;
+        oss.precision(precision(engine));
+        oss << f;
+
+        cells.push_back(oss.str());
+        ofs << cells.back() << std::endl;
+    }
+    ofs.close();
+
+    DataFrame df;
+    df.load_csv(path);
+    std::remove(path);
+
+    REQUIRE(df.n_rows() == n_rows);
+
+    for (auto i = 0u; i < n_rows; i++) {
+        const auto expected = std::strtof(cells[i].c_str(), nullptr);
+
+        REQUIRE(df.columns[0][i] == expected);
+    }
+}
+
+TEST_CASE("Load a column range from HDF5 file", "[dataframe]")
+{
+    DataFrame df, range;
+    df.load_hdf5("xmap_all_to_all_test.h5", "values");
+    range.load_hdf5("xmap_all_to_all_test.h5", "values", 3, 7);
+
+    REQUIRE(range.n_rows() == df.n_rows());
+    REQUIRE(range.n_columns() == 4);
+
+    for (auto i = 0u; i < range.n_rows(); i++) {
+        for (auto j = 0u; j < range.n_columns(); j++) {
+            REQUIRE(range.columns[j][i] == df.columns[j + 3][i]);
+        }
+    }
+
+    REQUIRE_THROWS_AS(
+        range.load_hdf5("xmap_all_to_all_test.h5", "values", 7, 3),
+        std::invalid_argument);
+}
+
+TEST_CASE("Save and map binary file", "[dataframe]")
+{
+    const auto path = "data_frame_test_tmp.mpedm";
+
+    DataFrame df, mapped;
+    df.load_csv("sardine_anchovy_sst.csv");
+    df.save_binary(path);
+    mapped.load_binary(path);
+
+    REQUIRE(mapped.is_mapped());
+    REQUIRE(mapped.n_rows() == df.n_rows());
+    REQUIRE(mapped.n_columns() == df.n_columns());
+    REQUIRE(mapped.names == df.names);
+    REQUIRE(mapped.names[1] == "anchovy");
+
+    for (auto i = 0u; i < df.n_rows(); i++) {
+        for (auto j = 0u; j < df.n_columns(); j++) {
+            REQUIRE(mapped.columns[j][i] == df.columns[j][i]);
+        }
+    }
+
+    // Frames over external buffers switch to the mapping
+    const std::vector<float> buffer(4 * 3, -1.0f);
+    DataFrame external(buffer.data(), 4, 3, nullptr);
+    external.load_binary(path);
+
+    REQUIRE(external.is_mapped());
+    REQUIRE(external.n_rows() == df.n_rows());
+    REQUIRE(external.names == df.names);
+    REQUIRE(external.data() != buffer.data());
+    REQUIRE(external.columns[1][0] == df.columns[1][0]);
+
+    // Copies are held in memory and outlive the mapping
+    const DataFrame copy = mapped;
+    mapped.load_csv("knn_test_data.csv");
+    std::remove(path);
+
+    REQUIRE(!copy.is_mapped());
+    REQUIRE(copy.columns[1][0] == df.columns[1][0]);
+
+    REQUIRE_THROWS_AS(mapped.load_binary("sardine_anchovy_sst.csv"),
+                      std::invalid_argument);
+}
@@ -0,0 +1,58 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/edge_list.h"
+
+TEST_CASE("Keep top-K edges per target", "[edges]")
+{
+    EdgeCollector edges(2, 2, -std::numeric_limits<float>::infinity());
+
+    edges.add_row(0, {0.1f, 0.9f});
+    edges.add_row(1, {0.5f, NAN});
+    edges.add_row(2, {0.3f, 0.2f});
+    edges.add_row(3, {0.7f, 0.8f});
+
+    const auto csr = edges.to_csr();
+
+    REQUIRE(csr.indptr == std::vector<uint64_t>({0, 2, 4}));
+    REQUIRE(csr.indices == std::vector<uint32_t>({3, 1, 0, 3}));
+    REQUIRE(csr.data == std::vector<float>({0.7f, 0.5f, 0.9f, 0.8f}));
+}
+
+TEST_CASE("Keep edges above threshold", "[edges]")
+{
+    EdgeCollector edges(2, 0, 0.5f);
+
+    edges.add_row(0, {0.1f, 0.9f});
+    edges.add_row(1, {0.5f, 0.4f});
+
+    const auto csr = edges.to_csr();
+
+    REQUIRE(csr.indptr == std::vector<uint64_t>({0, 1, 2}));
+    REQUIRE(csr.indices == std::vector<uint32_t>({1, 0}));
+}
+
+TEST_CASE("Merge partial edge lists", "[edges]")
+{
+    const auto no_threshold = -std::numeric_limits<float>::infinity();
+
+    // Libraries split across two workers
+    EdgeCollector worker1(1, 2, no_threshold), worker2(1, 2, no_threshold);
+    EdgeCollector all(1, 2, no_threshold), merged(1, 2, no_threshold);
+
+    const std::vector<float> rhos = {0.4f, 0.1f, 0.8f, 0.6f};
+
+    for (auto i = 0u; i < rhos.size(); i++) {
+        (i % 2 ? worker1 : worker2).add_row(i, {rhos[i]});
+        all.add_row(i, {rhos[i]});
+    }
+
+    merged.merge(worker1.edges());
+    merged.merge(worker2.edges());
+
+    REQUIRE(merged.to_csr().indices == all.to_csr().indices);
+    REQUIRE(merged.to_csr().indices == std::vector<uint32_t>({2, 3}));
+}
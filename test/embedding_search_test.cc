@@ -0,0 +1,119 @@
+#include <stdexcept>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/embedding_search.h"
+
+// Run a search over a skill curve where rhos[E - 1] is the skill of E and
+// return the embedding dimensions it evaluated
+static std::vector<uint32_t> run_search(EmbeddingSearch &search,
+                                        const std::vector<float> &rhos)
+{
+    std::vector<uint32_t> evaluated;
+
+    search.reset();
+
+    for (auto Es = search.next(); !Es.empty(); Es = search.next()) {
+        for (const auto E : Es) {
+            search.report(E, rhos[E - 1]);
+            evaluated.push_back(E);
+        }
+    }
+
+    return evaluated;
+}
+
+// Skill rising up to E=5 and declining smoothly afterwards
+static const std::vector<float> peaked = {
+    0.50f, 0.70f, 0.80f, 0.85f, 0.90f, 0.88f, 0.86f, 0.84f, 0.82f, 0.80f,
+    0.78f, 0.76f, 0.74f, 0.72f, 0.70f, 0.68f, 0.66f, 0.64f, 0.62f, 0.60f};
+
+TEST_CASE("Exhaustive search evaluates every E", "[search]")
+{
+    EmbeddingSearch search(20);
+
+    const auto evaluated = run_search(search, peaked);
+
+    REQUIRE(evaluated.size() == 20);
+    REQUIRE(search.best_E() == 5);
+    REQUIRE(search.n_evaluated() == 20);
+    REQUIRE(search.n_exhaustive() == 20);
+}
+
+TEST_CASE("Exhaustive search breaks ties towards smaller E", "[search]")
+{
+    EmbeddingSearch search(4);
+
+    run_search(search, {0.1f, 0.5f, 0.5f, 0.2f});
+
+    REQUIRE(search.best_E() == 2);
+}
+
+TEST_CASE("Patience search stops after rho stops improving", "[search]")
+{
+    EmbeddingSearch search(20, "patience", 3);
+
+    const auto evaluated = run_search(search, peaked);
+
+    REQUIRE(evaluated == std::vector<uint32_t>({1, 2, 3, 4, 5, 6, 7, 8}));
+    REQUIRE(search.best_E() == 5);
+    REQUIRE(search.n_evaluated() == 8);
+    REQUIRE(search.n_exhaustive() == 20);
+}
+
+TEST_CASE("Patience search reaches max_E on rising skill", "[search]")
+{
+    EmbeddingSearch search(5, "patience", 1);
+
+    const auto evaluated = run_search(search, {0.1f, 0.2f, 0.3f, 0.4f, 0.5f});
+
+    REQUIRE(evaluated.size() == 5);
+    REQUIRE(search.best_E() == 5);
+}
+
+TEST_CASE("Coarse search refines around the best grid point", "[search]")
+{
+    EmbeddingSearch search(20, "coarse", 3, 4);
+
+    const auto evaluated = run_search(search, peaked);
+
+    // Grid 1, 5, 9, 13, 17, 20 followed by 2-4 and 6-8 around E=5
+    REQUIRE(evaluated == std::vector<uint32_t>({1, 5, 9, 13, 17, 20, 2, 3, 4,
+                                                6, 7, 8}));
+    REQUIRE(search.best_E() == 5);
+}
+
+TEST_CASE("Coarse search finds a peak between grid points", "[search]")
+{
+    std::vector<float> rhos(20, 0.0f);
+    for (auto E = 1u; E <= 20; E++) {
+        rhos[E - 1] = 1.0f - 0.01f * (E - 7) * (E - 7);
+    }
+
+    EmbeddingSearch search(20, "coarse", 3, 4);
+    run_search(search, rhos);
+
+    REQUIRE(search.best_E() == 7);
+    REQUIRE(search.n_evaluated() < 20);
+}
+
+TEST_CASE("Evaluation counts accumulate across searches", "[search]")
+{
+    EmbeddingSearch search(20, "patience", 3);
+
+    run_search(search, peaked);
+    run_search(search, peaked);
+
+    REQUIRE(search.n_evaluated() == 16);
+    REQUIRE(search.n_exhaustive() == 40);
+}
+
+TEST_CASE("Unknown search policies are rejected", "[search]")
+{
+    REQUIRE_THROWS_AS(EmbeddingSearch(20, "random"), std::invalid_argument);
+    REQUIRE_THROWS_AS(EmbeddingSearch(20, "patience", 0),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(EmbeddingSearch(20, "coarse", 3, 0),
+                      std::invalid_argument);
+}
@@ -54,6 +54,30 @@ TEST_CASE("Compute k-NN lookup table (CPU, E=5)", "[knn][cpu]")
     knn_test_common<NearestNeighborsCPU>(5);
 }
 
+TEST_CASE("Compute k-NN lookup table within memory budget (CPU)",
+          "[knn][cpu]")
+{
+    DataFrame df;
+    df.load_csv("knn_test_data.csv");
+
+    NearestNeighborsCPU knn(1, 0, true);
+    LUT lut, lut_chunked;
+
+    knn.compute_lut(lut, df.columns[0], df.columns[0], 3, 4);
+
+    // Smallest possible budget forces one target row per chunk
+    knn.set_memory_budget(1);
+    knn.compute_lut(lut_chunked, df.columns[0], df.columns[0], 3, 4);
+
+    REQUIRE(lut_chunked.n_rows() == lut.n_rows());
+    REQUIRE(lut_chunked.n_columns() == lut.n_columns());
+
+    for (auto i = 0u; i < lut.n_rows() * lut.n_columns(); i++) {
+        REQUIRE(lut_chunked.indices[i] == lut.indices[i]);
+        REQUIRE(lut_chunked.distances[i] == lut.distances[i]);
+    }
+}
+
 #ifdef ENABLE_GPU_KERNEL
 
 TEST_CASE("Compute k-NN lookup table (GPU, E=2)", "[knn][gpu]")
@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <highfive/H5File.hpp>
+
+#include "../src/checkpoint.h"
+#include "../src/output_layout.h"
+#include "../src/row_writer.h"
+
+// Keeps rows in memory and records the size of every write
+class MemoryRowWriter : public RowWriter
+{
+public:
+    MemoryRowWriter(size_t n_rows, size_t n_columns)
+        : RowWriter(n_columns), values(n_rows * n_columns, -1.0f)
+    {
+    }
+
+    void write_rows(size_t start, size_t n_rows, const float *rows) override
+    {
+        if (start + n_rows > values.size() / _n_columns) {
+            throw std::out_of_range("Row out of bounds");
+        }
+
+        std::copy(rows, rows + n_rows * _n_columns,
+                  values.begin() + start * _n_columns);
+        writes.push_back(n_rows);
+    }
+
+    std::vector<float> values;
+    std::vector<size_t> writes;
+};
+
+TEST_CASE("Aggregate rows into blocks", "[io]")
+{
+    const auto n_rows = 10u, n_columns = 3u;
+
+    MemoryRowWriter sink(n_rows, n_columns);
+
+    {
+        AsyncRowWriter writer(sink, 4, 1);
+
+        for (auto i = 0u; i < n_rows; i++) {
+            const std::vector<float> row(n_columns, static_cast<float>(i));
+
+            writer.write_rows(i, 1, row.data());
+        }
+
+        writer.flush();
+    }
+
+    for (auto i = 0u; i < n_rows * n_columns; i++) {
+        REQUIRE(sink.values[i] == static_cast<float>(i / n_columns));
+    }
+
+    REQUIRE(sink.writes == std::vector<size_t>({4, 4, 2}));
+}
+
+TEST_CASE("Start a new block for non-consecutive rows", "[io]")
+{
+    MemoryRowWriter sink(10, 1);
+
+    {
+        AsyncRowWriter writer(sink, 4);
+        const float rows[] = {1.0f, 2.0f, 3.0f};
+
+        writer.write_rows(0, 2, rows);
+        writer.write_rows(5, 1, rows + 2);
+    }
+
+    REQUIRE(sink.values[0] == 1.0f);
+    REQUIRE(sink.values[1] == 2.0f);
+    REQUIRE(sink.values[2] == -1.0f);
+    REQUIRE(sink.values[5] == 3.0f);
+    REQUIRE(sink.writes == std::vector<size_t>({2, 1}));
+}
+
+TEST_CASE("Submit ends a block even for consecutive rows", "[io]")
+{
+    MemoryRowWriter sink(10, 1);
+
+    {
+        AsyncRowWriter writer(sink, 4);
+        const float rows[] = {1.0f, 2.0f, 3.0f};
+
+        // Nothing to submit yet
+        writer.submit();
+        writer.write_rows(0, 2, rows);
+        writer.submit();
+        writer.submit();
+        writer.write_rows(2, 1, rows + 2);
+    }
+
+    REQUIRE(sink.values[2] == 3.0f);
+    REQUIRE(sink.writes == std::vector<size_t>({2, 1}));
+}
+
+TEST_CASE("Rethrow errors from the background thread", "[io]")
+{
+    MemoryRowWriter sink(1, 1);
+    AsyncRowWriter writer(sink, 1);
+    const float row = 1.0f;
+
+    writer.write_rows(5, 1, &row);
+
+    REQUIRE_THROWS_AS(writer.flush(), std::out_of_range);
+}
+
+void quantization_test_common(const std::string &quantization, float margin)
+{
+    const auto path = "row_writer_test_tmp.h5";
+    const std::vector<float> rows = {-1.0f, -0.5f, 0.0f, 0.25f, 0.999f, 1.0f};
+
+    std::vector<float> values;
+
+    {
+        HighFive::File file(path, HighFive::File::Overwrite);
+
+        OutputLayout layout;
+        layout.chunk_rows = 2;
+        layout.compression = 4;
+        layout.quantization = quantization;
+
+        auto dataset = create_float_dataset(file, "values", 3, 2, layout);
+        HDF5RowWriter writer(dataset);
+
+        writer.write_rows(0, 3, rows.data());
+
+        if (quantization == "int8") {
+            std::vector<int8_t> quantized(rows.size());
+            dataset.read(quantized.data());
+
+            for (const auto q : quantized) {
+                values.push_back(q / 127.0f);
+            }
+        } else {
+            values.resize(rows.size());
+            dataset.read(values.data());
+        }
+    }
+    std::remove(path);
+
+    REQUIRE(values.size() == rows.size());
+
+    for (auto i = 0u; i < rows.size(); i++) {
+        REQUIRE(values[i] == Catch::Approx(rows[i]).margin(margin));
+    }
+}
+
+TEST_CASE("Write chunked and compressed HDF5 dataset", "[io]")
+{
+    quantization_test_common("none", 0.0f);
+}
+
+TEST_CASE("Write fp16 quantized HDF5 dataset", "[io]")
+{
+    quantization_test_common("fp16", 1e-3f);
+}
+
+TEST_CASE("Write int8 quantized HDF5 dataset", "[io]")
+{
+    quantization_test_common("int8", 0.5f / 127.0f);
+}
+
+TEST_CASE("Write rows to memory-mapped raw file", "[io]")
+{
+    const auto path = "row_writer_test.raw";
+    const auto n_rows = 4u, n_columns = 3u;
+    std::vector<float> row{1.0f, 2.0f, 3.0f};
+
+    {
+        MmapRowWriter writer(path, n_rows, n_columns);
+
+        // Rows are either filled in place or copied into the mapping
+        for (auto i = 0u; i < n_rows; i += 2) {
+            std::fill(writer.row(i), writer.row(i) + n_columns, i);
+            writer.write_rows(i, 1, writer.row(i));
+            writer.write_rows(i + 1, 1, row.data());
+        }
+
+        writer.flush();
+    }
+
+    std::vector<float> values(n_rows * n_columns + 1);
+    const auto fp = std::fopen(path, "rb");
+    REQUIRE(fp);
+    const auto n_read =
+        std::fread(values.data(), sizeof(float), values.size(), fp);
+    std::fclose(fp);
+    std::remove(path);
+
+    REQUIRE(n_read == n_rows * n_columns);
+
+    for (auto i = 0u; i < n_rows; i++) {
+        for (auto j = 0u; j < n_columns; j++) {
+            const auto expected = i % 2 ? row[j] : static_cast<float>(i);
+            REQUIRE(values[i * n_columns + j] == expected);
+        }
+    }
+}
+
+TEST_CASE("Record completed rows in progress record", "[io]")
+{
+    const auto path = "row_writer_test_checkpoint.h5";
+    const auto n_rows = 6u, n_columns = 2u;
+    const std::vector<float> rows(2 * n_columns, 1.0f);
+
+    {
+        HighFive::File file(path, HighFive::File::Overwrite);
+        Checkpoint checkpoint(file, n_rows);
+        MemoryRowWriter sink(n_rows, n_columns);
+        CheckpointRowWriter writer(sink, checkpoint, true);
+
+        REQUIRE(checkpoint.n_completed() == 0);
+
+        writer.write_rows(1, 2, rows.data());
+        writer.write_rows(5, 1, rows.data());
+        writer.flush();
+
+        REQUIRE(sink.writes == std::vector<size_t>{2, 1});
+    }
+
+    {
+        HighFive::File file(path, HighFive::File::ReadWrite);
+        Checkpoint checkpoint(file, n_rows);
+
+        REQUIRE(checkpoint.n_completed() == 3);
+        REQUIRE(checkpoint.completed_flags() ==
+                std::vector<uint8_t>{0, 1, 1, 0, 0, 1});
+
+        REQUIRE_THROWS_AS(Checkpoint(file, n_rows + 1),
+                          std::invalid_argument);
+    }
+
+    std::remove(path);
+}
+
+TEST_CASE("Continue the output of a previous run", "[io]")
+{
+    const std::vector<uint8_t> finished(6, 1), interrupted{1, 1, 0, 1, 0, 0};
+
+    // Appending to a finished or interrupted output of the full size reuses
+    // every E and leaves the rows to the progress record
+    for (const auto &completed : {finished, interrupted}) {
+        for (const auto append : {false, true}) {
+            const auto plan = plan_continuation(6, append, 6, completed);
+
+            REQUIRE(plan.n_known_E == 6);
+            REQUIRE(plan.n_old == 0);
+        }
+    }
+
+    // Only the columns appended to a finished run are new
+    const auto plan = plan_continuation(8, true, 6, finished);
+
+    REQUIRE(plan.n_known_E == 6);
+    REQUIRE(plan.n_old == 6);
+
+    REQUIRE_THROWS_AS(plan_continuation(8, true, 6, interrupted),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(plan_continuation(8, false, 6, finished),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(plan_continuation(4, true, 6, finished),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(plan_continuation(8, true, 5, finished),
+                      std::invalid_argument);
+}
+
+void resize_test_common(const OutputLayout &layout)
+{
+    const auto path = "row_writer_test_resize.h5";
+    const std::vector<float> old_rows = {1.0f, 2.0f, 3.0f, 4.0f};
+    const std::vector<float> new_rows = {5.0f, 6.0f};
+
+    std::vector<float> values;
+
+    {
+        HighFive::File file(path, HighFive::File::Overwrite);
+        HDF5RowWriter(create_float_dataset(file, "/corrcoef", 2, 2, layout))
+            .write_rows(0, 2, old_rows.data());
+
+        const auto dataset = resize_float_dataset(file, "/corrcoef", 3, 3);
+
+        REQUIRE(dataset.getDimensions() == std::vector<size_t>{3, 3});
+        REQUIRE_THROWS_AS(resize_float_dataset(file, "/corrcoef", 2, 3),
+                          std::invalid_argument);
+
+        // Fill in the new column of the old rows
+        HDF5RowWriter(dataset, 2, 1).write_rows(0, 2, new_rows.data());
+
+        values.resize(9);
+        dataset.read(values.data());
+    }
+    std::remove(path);
+
+    const std::vector<float> expected = {1.0f, 2.0f, 5.0f, 3.0f, 4.0f,
+                                         6.0f, 0.0f, 0.0f, 0.0f};
+
+    REQUIRE(values == expected);
+}
+
+TEST_CASE("Grow chunked HDF5 dataset in place", "[io]")
+{
+    OutputLayout layout;
+    layout.chunk_rows = 1;
+
+    resize_test_common(layout);
+}
+
+TEST_CASE("Grow contiguous HDF5 dataset by copying", "[io]")
+{
+    resize_test_common(OutputLayout());
+}
@@ -1,9 +1,14 @@
 #include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
 
 #include "../src/data_frame.h"
+#include "../src/embedding_dim_cpu.h"
 #include "../src/lut.h"
 #include "../src/nearest_neighbors_cpu.h"
 #ifdef ENABLE_GPU_KERNEL
@@ -35,7 +40,7 @@ template <class T, class U> void simplex_test_common(int E)
     knn->compute_lut(lut, library, target, E, E + 1);
     lut.normalize();
 
-    std::vector<float> buffer;
+    scratch_vector<float> buffer;
 
     const auto prediction = simplex->predict(buffer, lut, library, E);
 
@@ -107,7 +112,7 @@ template <class T, class U> void embed_dim_test_common()
     auto knn = std::unique_ptr<NearestNeighbors>(new T(tau, Tp, true));
     auto simplex = std::unique_ptr<Simplex>(new U(tau, Tp, true));
 
-    std::vector<float> buffer;
+    scratch_vector<float> buffer;
     LUT lut;
     std::vector<float> rho(max_E);
     std::vector<float> rho_valid(max_E);
@@ -142,6 +147,130 @@ TEST_CASE("Find optimal embedding dimension (CPU)", "[simplex][cpu]")
     embed_dim_test_common<NearestNeighborsCPU, SimplexCPU>();
 }
 
+// Select E by predicting every point of `ts` from its E + 1 nearest
+// neighbors outside of its fold, searching the neighbors by brute force
+static uint32_t cross_validated_E(const Series &ts, uint32_t max_E,
+                                  size_t n_folds)
+{
+    std::vector<float> rhos;
+
+    for (auto E = 1u; E <= max_E; E++) {
+        const auto shift = E;
+        const auto n = ts.size() - shift;
+        const auto folds = std::min(n_folds, n);
+
+        std::vector<float> prediction, actual;
+
+        for (auto i = 0u; i < n; i++) {
+            std::vector<std::pair<float, uint32_t>> neighbors;
+
+            for (auto j = 0u; j < n; j++) {
+                if (j * folds / n == i * folds / n) {
+                    continue;
+                }
+
+                auto ssd = 0.0f;
+                for (auto k = 0u; k < E; k++) {
+                    ssd += (ts[i + k] - ts[j + k]) * (ts[i + k] - ts[j + k]);
+                }
+                neighbors.push_back(std::make_pair(std::sqrt(ssd), j));
+            }
+
+            std::stable_sort(neighbors.begin(), neighbors.end());
+            neighbors.resize(E + 1);
+
+            const auto min_dist = neighbors[0].first;
+            auto sum = 0.0f, sum_weights = 0.0f;
+
+            for (const auto &nb : neighbors) {
+                auto weight = min_dist > 0.0f ? std::exp(-nb.first / min_dist)
+                                              : (nb.first > 0.0f ? 0.0f : 1.0f);
+                weight = std::max(weight, 1e-6f);
+
+                sum += weight * ts[nb.second + shift];
+                sum_weights += weight;
+            }
+
+            prediction.push_back(sum / sum_weights);
+            actual.push_back(ts[i + shift]);
+        }
+
+        rhos.push_back(corrcoef(Series(prediction), Series(actual)));
+    }
+
+    return std::max_element(rhos.begin(), rhos.end()) - rhos.begin() + 1;
+}
+
+TEST_CASE("Find optimal embedding dimension by cross validation (CPU)",
+          "[simplex][cpu]")
+{
+    DataFrame df;
+    df.load_csv("sardine_anchovy_sst.csv");
+
+    for (const auto n_folds : {2u, 5u, EmbeddingDim::leave_one_out}) {
+        EmbeddingDimCPU embedding_dim(10, 1, 1, false);
+
+        embedding_dim.set_folds(n_folds);
+
+        // Chunked distance rows give the same neighbors
+        embedding_dim.set_memory_budget(n_folds == 5 ? 1 : 0);
+
+        std::vector<uint32_t> optimal_E;
+        for (const auto &ts : df.columns) {
+            const auto E = embedding_dim.run(ts);
+
+            REQUIRE(E == cross_validated_E(ts, 10, n_folds));
+            optimal_E.push_back(E);
+        }
+
+        REQUIRE(embedding_dim.run_batch(df.columns) == optimal_E);
+    }
+}
+
+TEST_CASE("Reject folds too small to cross validate (CPU)", "[simplex][cpu]")
+{
+    // Several columns so that the pairs of a round are evaluated in parallel
+    const size_t n_rows = 40, n_columns = 8;
+    std::vector<float> data(n_rows * n_columns);
+    for (auto i = 0u; i < data.size(); i++) {
+        data[i] = std::sin(0.3f * i);
+    }
+    const DataFrame df(data, n_rows, n_columns);
+
+    EmbeddingDimCPU embedding_dim(20, 1, 1, false);
+    embedding_dim.set_folds(2);
+
+    REQUIRE_THROWS_AS(embedding_dim.run(df.columns[0]),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(embedding_dim.run_batch(df.columns),
+                      std::invalid_argument);
+}
+
+TEST_CASE("Find optimal embedding dimensions of a batch (CPU)",
+          "[simplex][cpu]")
+{
+    DataFrame df;
+    df.load_csv("sardine_anchovy_sst.csv");
+
+    // The series are short, so keep E small enough for the library to hold
+    // E + 1 neighbors
+    for (const auto &policy : {"exhaustive", "patience", "coarse"}) {
+        EmbeddingDimCPU single(10, 1, 1, false), batch(10, 1, 1, false);
+
+        single.set_search_policy(policy, 3, 4);
+        batch.set_search_policy(policy, 3, 4);
+
+        std::vector<uint32_t> optimal_E;
+        for (const auto &ts : df.columns) {
+            optimal_E.push_back(single.run(ts));
+        }
+
+        REQUIRE(batch.run_batch(df.columns) == optimal_E);
+        REQUIRE(batch.n_evaluated() == single.n_evaluated());
+        REQUIRE(batch.n_exhaustive() == single.n_exhaustive());
+    }
+}
+
 #ifdef ENABLE_GPU_KERNEL
 
 TEST_CASE("Find optimal embedding dimension (GPU)", "[simplex][gpu]")
@@ -0,0 +1,56 @@
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/task_planner.h"
+
+TEST_CASE("Split libraries left to do into fixed-size tasks", "[planner]")
+{
+    const std::vector<double> costs(10, 1.0);
+    const std::vector<uint8_t> completed = {0, 0, 0, 1, 0, 0, 0, 0, 0, 1};
+
+    const auto tasks = plan_fixed_tasks(costs, completed, 3);
+
+    REQUIRE(tasks.size() == 3);
+    REQUIRE(tasks[0].start == 0);
+    REQUIRE(tasks[0].stop == 3);
+    REQUIRE(tasks[1].start == 4);
+    REQUIRE(tasks[1].stop == 7);
+    REQUIRE(tasks[2].start == 7);
+    REQUIRE(tasks[2].stop == 9);
+    REQUIRE(tasks[2].cost == 2.0);
+}
+
+TEST_CASE("Guided tasks shrink and are ordered by cost", "[planner]")
+{
+    const std::vector<double> costs(100, 1.0);
+    std::vector<uint8_t> completed(100, 0);
+    completed[50] = 1;
+
+    const auto tasks = plan_guided_tasks(costs, completed, 4, 2);
+
+    std::vector<uint8_t> covered(100, 0);
+
+    for (size_t i = 0; i < tasks.size(); i++) {
+        REQUIRE(tasks[i].stop - tasks[i].start >= 1);
+        REQUIRE(tasks[i].cost == tasks[i].stop - tasks[i].start);
+
+        if (i > 0) {
+            REQUIRE(tasks[i - 1].cost >= tasks[i].cost);
+        }
+
+        for (auto id = tasks[i].start; id < tasks[i].stop; id++) {
+            covered[id]++;
+        }
+    }
+
+    // Every library left to do is in exactly one task
+    for (size_t id = 0; id < covered.size(); id++) {
+        REQUIRE(covered[id] == (id == 50 ? 0 : 1));
+    }
+
+    // The first task holds 1 / (2 * 4) of all work, the last ones the
+    // minimum chunk
+    REQUIRE(tasks.front().cost == 13.0);
+    REQUIRE(tasks.back().cost <= 2.0);
+}
@@ -0,0 +1,140 @@
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/thread_scheduler.h"
+
+// Issues tasks of `chunk_size` ids and counts how often each id finished
+class CountingMaster : public TaskMaster
+{
+public:
+    CountingMaster(size_t n_ids, size_t chunk_size)
+        : finished(n_ids, 0), current_id(0), chunk_size(chunk_size)
+    {
+    }
+
+    std::vector<int> finished;
+
+protected:
+    size_t current_id;
+    size_t chunk_size;
+
+    void next_task(Task &task) override
+    {
+        task.start = current_id;
+        task.stop = std::min(current_id + chunk_size, finished.size());
+        current_id = task.stop;
+    }
+
+    bool task_left() const override { return current_id < finished.size(); }
+
+    void task_done(const TaskResult &result) override
+    {
+        for (auto id = result.start; id < result.stop; id++) {
+            finished[id]++;
+        }
+    }
+};
+
+// Returns the range of its task and fails on `bad_id`
+class RangeWorker : public TaskWorker
+{
+public:
+    explicit RangeWorker(size_t bad_id) : bad_id(bad_id) {}
+
+protected:
+    size_t bad_id;
+
+    void do_task(TaskResult &result, const Task &task) override
+    {
+        if (task.start <= bad_id && bad_id < task.stop) {
+            throw std::runtime_error("Bad task");
+        }
+
+        result.start = task.start;
+        result.stop = task.stop;
+    }
+};
+
+TEST_CASE("Run every task once on a pool of threads", "[scheduler]")
+{
+    CountingMaster master(1000, 3);
+    const size_t none = 1000;
+    RangeWorker worker1(none), worker2(none), worker3(none), worker4(none);
+
+    ThreadScheduler scheduler;
+    scheduler.run(master, {&worker1, &worker2, &worker3, &worker4});
+
+    for (const auto count : master.finished) {
+        REQUIRE(count == 1);
+    }
+
+    uint64_t n_tasks = 0;
+    for (const auto n : scheduler.tasks_per_worker()) {
+        n_tasks += n;
+    }
+    REQUIRE(n_tasks == 334);
+}
+
+TEST_CASE("Rethrow errors of worker threads", "[scheduler]")
+{
+    CountingMaster master(100, 1);
+    RangeWorker worker1(50), worker2(50);
+
+    ThreadScheduler scheduler;
+
+    REQUIRE_THROWS_AS(scheduler.run(master, {&worker1, &worker2}),
+                      std::runtime_error);
+    REQUIRE(master.finished[50] == 0);
+}
+
+// Counts the tasks run by its thread, which would restart from zero on a
+// new thread
+class ThreadCountingWorker : public TaskWorker
+{
+public:
+    ThreadCountingWorker()
+        : n_thread_tasks(0), on_caller(false),
+          caller(std::this_thread::get_id())
+    {
+    }
+
+    size_t n_thread_tasks;
+    bool on_caller;
+
+protected:
+    void do_task(TaskResult &result, const Task &task) override
+    {
+        static thread_local size_t count = 0;
+
+        n_thread_tasks = ++count;
+        on_caller = on_caller || std::this_thread::get_id() == caller;
+
+        result.start = task.start;
+        result.stop = task.stop;
+    }
+
+    std::thread::id caller;
+};
+
+TEST_CASE("Keep worker threads between runs", "[scheduler]")
+{
+    ThreadCountingWorker worker1, worker2;
+    ThreadScheduler scheduler;
+
+    for (auto i = 0; i < 3; i++) {
+        CountingMaster master(100, 1);
+        scheduler.run(master, {&worker1, &worker2});
+
+        for (const auto count : master.finished) {
+            REQUIRE(count == 1);
+        }
+    }
+
+    // Each worker stayed on one thread for all three runs
+    REQUIRE(worker1.n_thread_tasks + worker2.n_thread_tasks == 300);
+    REQUIRE(!worker1.on_caller);
+    REQUIRE(!worker2.on_caller);
+}
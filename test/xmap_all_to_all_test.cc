@@ -1,8 +1,11 @@
+#include <cstdio>
+
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <highfive/H5DataSet.hpp>
 #include <highfive/H5File.hpp>
 
+#include "../src/column_cache.h"
 #include "../src/cross_mapping_cpu.h"
 #include "../src/data_frame.h"
 #include "../src/embedding_dim_cpu.h"
@@ -12,12 +15,10 @@
 #endif
 
 void xmap_all_to_all_test_common(const HighFive::File &file,
+                                 const DataFrame &df,
                                  std::unique_ptr<EmbeddingDim> edim,
                                  std::unique_ptr<CrossMapping> xmap)
 {
-    DataFrame df;
-    df.load_hdf5("xmap_all_to_all_test.h5", "values");
-
     const auto ds_corrcoef = file.getDataSet("corrcoef");
     const auto ds_edim = file.getDataSet("embedding");
 
@@ -45,6 +46,16 @@ void xmap_all_to_all_test_common(const HighFive::File &file,
     }
 }
 
+void xmap_all_to_all_test_common(const HighFive::File &file,
+                                 std::unique_ptr<EmbeddingDim> edim,
+                                 std::unique_ptr<CrossMapping> xmap)
+{
+    DataFrame df;
+    df.load_hdf5("xmap_all_to_all_test.h5", "values");
+
+    xmap_all_to_all_test_common(file, df, std::move(edim), std::move(xmap));
+}
+
 TEST_CASE("Compute all-to-all cross mappings (CPU)", "[ccm][cpu]")
 {
     const HighFive::File file("xmap_all_to_all_test_validation.h5");
@@ -58,6 +69,53 @@ TEST_CASE("Compute all-to-all cross mappings (CPU)", "[ccm][cpu]")
     xmap_all_to_all_test_common(file, std::move(edim), std::move(xmap));
 }
 
+TEST_CASE("Compute all-to-all cross mappings within memory budget (CPU)",
+          "[ccm][cpu]")
+{
+    const HighFive::File file("xmap_all_to_all_test_validation.h5");
+
+    auto edim =
+        std::unique_ptr<EmbeddingDim>(new EmbeddingDimCPU(20, 1, 1, true));
+
+    auto xmap =
+        std::unique_ptr<CrossMapping>(new CrossMappingCPU(20, 1, 0, true));
+
+    // Smallest possible budget computes one lookup table at a time
+    edim->set_memory_budget(1);
+    xmap->set_memory_budget(1);
+
+    xmap_all_to_all_test_common(file, std::move(edim), std::move(xmap));
+}
+
+TEST_CASE("Compute all-to-all cross mappings out of core (CPU)",
+          "[ccm][cpu]")
+{
+    const HighFive::File file("xmap_all_to_all_test_validation.h5");
+    const auto path = "xmap_all_to_all_test_tmp.mpedm";
+
+    DataFrame df;
+    df.load_hdf5("xmap_all_to_all_test.h5", "values");
+    df.save_binary(path);
+    df.load_binary(path);
+    std::remove(path);
+
+    // Smallest possible cache streams one column at a time
+    ColumnCache cache(df, 1);
+
+    auto edim =
+        std::unique_ptr<EmbeddingDim>(new EmbeddingDimCPU(20, 1, 1, true));
+
+    auto xmap =
+        std::unique_ptr<CrossMapping>(new CrossMappingCPU(20, 1, 0, true));
+
+    xmap->set_column_cache(&cache);
+
+    xmap_all_to_all_test_common(file, df, std::move(edim), std::move(xmap));
+
+    REQUIRE(cache.misses() > 0);
+    REQUIRE(cache.evictions() > 0);
+}
+
 #ifdef ENABLE_GPU_KERNEL
 
 TEST_CASE("Compute all-to-all cross mappings (GPU)", "[ccm][gpu]")
@@ -38,7 +38,7 @@ template <class T, class U> void cross_mapping_test_common(uint32_t E)
     knn->compute_lut(lut, library, library, E);
     lut.normalize();
 
-    std::vector<float> buffer;
+    scratch_vector<float> buffer;
 
     const auto prediction = simplex->predict(buffer, lut, target, E);
 